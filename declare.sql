@@ -1,9 +1,47 @@
 DROP FUNCTION levenshtein;
 DROP FUNCTION double_metaphone_eq;
+DROP FUNCTION double_metaphone_primary;
+DROP FUNCTION double_metaphone_secondary;
+DROP FUNCTION double_metaphone_key;
+DROP FUNCTION ru_phonetic_key;
 DROP FUNCTION jaro_winkler;
 DROP FUNCTION dice;
+DROP FUNCTION dice_profile;
+DROP FUNCTION dice_profile_sim;
+DROP FUNCTION token_jaccard;
+DROP FUNCTION token_sort_ratio;
+DROP FUNCTION token_set_ratio;
+DROP FUNCTION fuzzy_contains;
+DROP FUNCTION fuzzy_position;
+DROP FUNCTION local_alignment_score;
+DROP FUNCTION hamming;
+DROP FUNCTION hamming_bits;
+DROP FUNCTION minhash_sig;
+DROP FUNCTION simhash64;
+DROP FUNCTION string_similarity;
+DROP FUNCTION fuzzy_cluster;
+DROP FUNCTION mymetrics_isa;
 
 CREATE FUNCTION levenshtein RETURNS INTEGER SONAME 'libmymetrics.so';
 CREATE FUNCTION double_metaphone_eq RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION double_metaphone_primary RETURNS STRING SONAME 'libmymetrics.so';
+CREATE FUNCTION double_metaphone_secondary RETURNS STRING SONAME 'libmymetrics.so';
+CREATE FUNCTION double_metaphone_key RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION ru_phonetic_key RETURNS STRING SONAME 'libmymetrics.so';
 CREATE FUNCTION jaro_winkler RETURNS REAL SONAME 'libmymetrics.so';
 CREATE FUNCTION dice RETURNS REAL SONAME 'libmymetrics.so';
+CREATE FUNCTION dice_profile RETURNS STRING SONAME 'libmymetrics.so';
+CREATE FUNCTION dice_profile_sim RETURNS REAL SONAME 'libmymetrics.so';
+CREATE FUNCTION token_jaccard RETURNS REAL SONAME 'libmymetrics.so';
+CREATE FUNCTION token_sort_ratio RETURNS REAL SONAME 'libmymetrics.so';
+CREATE FUNCTION token_set_ratio RETURNS REAL SONAME 'libmymetrics.so';
+CREATE FUNCTION fuzzy_contains RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION fuzzy_position RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION local_alignment_score RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION hamming RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION hamming_bits RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION minhash_sig RETURNS STRING SONAME 'libmymetrics.so';
+CREATE FUNCTION simhash64 RETURNS INTEGER SONAME 'libmymetrics.so';
+CREATE FUNCTION string_similarity RETURNS STRING SONAME 'libmymetrics.so';
+CREATE AGGREGATE FUNCTION fuzzy_cluster RETURNS STRING SONAME 'libmymetrics.so';
+CREATE FUNCTION mymetrics_isa RETURNS STRING SONAME 'libmymetrics.so';
@@ -0,0 +1,90 @@
+#ifndef MYMETRICS_MYMETRICS_H
+#define MYMETRICS_MYMETRICS_H
+
+/*
+ * The metrics of the UDFs as a library, for in-process callers. Strings
+ * are passed as views and never copied: code points (u32view) or UTF-8
+ * bytes (utf8view). UTF-8 is decoded into the caller's scratch, so a
+ * thread that keeps one scratch allocates nothing once its buffers have
+ * grown. Link mymetrics_core (static or shared); the kernels for the cpu
+ * are picked on first use as in the UDFs.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace mymetrics {
+
+/* code points, not owned; wchar_t holds UTF-32 where the library builds */
+struct u32view {
+    const wchar_t *data;
+    size_t size;
+
+    u32view() : data(0), size(0) {}
+    u32view(const wchar_t *d, size_t n) : data(d), size(n) {}
+    u32view(const std::wstring &s) : data(s.data()), size(s.size()) {}
+#if __cplusplus >= 201703L
+    u32view(std::wstring_view s) : data(s.data()), size(s.size()) {}
+    u32view(std::u32string_view s) : data(reinterpret_cast<const wchar_t*>(s.data())), size(s.size()) {
+        static_assert(sizeof(wchar_t) == sizeof(char32_t), "wchar_t is not UTF-32 here");
+    }
+#endif
+};
+
+/* UTF-8 bytes, not owned */
+struct utf8view {
+    const char *data;
+    size_t size;
+
+    utf8view() : data(0), size(0) {}
+    utf8view(const char *d, size_t n) : data(d), size(n) {}
+    utf8view(const char *s) : data(s), size(strlen(s)) {}
+    utf8view(const std::string &s) : data(s.data()), size(s.size()) {}
+#if __cplusplus >= 201703L
+    utf8view(std::string_view s) : data(s.data()), size(s.size()) {}
+#endif
+};
+
+/* buffers reused from call to call, one per thread */
+struct scratch {
+    std::wstring a, b;
+    std::vector<uint64_t> bigrams_a, bigrams_b;
+};
+
+/* UTF-8 to code points, invalid bytes give U+FFFD; out keeps its capacity */
+void decode(utf8view s, std::wstring &out);
+
+/* edit distance; with max_dist, max_dist + 1 for anything farther, found early */
+unsigned int levenshtein(u32view a, u32view b);
+unsigned int levenshtein(u32view a, u32view b, unsigned int max_dist);
+unsigned int levenshtein(utf8view a, utf8view b, scratch &s);
+unsigned int levenshtein(utf8view a, utf8view b, unsigned int max_dist, scratch &s);
+
+/* Jaro-Winkler similarity, 0..1 */
+double jaro_winkler(u32view a, u32view b);
+double jaro_winkler(utf8view a, utf8view b, scratch &s);
+
+/* dice coefficient of the bigram sets, NaN for two strings of one character */
+double dice(u32view a, u32view b, scratch &s);
+double dice(utf8view a, utf8view b, scratch &s);
+
+/* whether the Double Metaphone codes are equal */
+bool double_metaphone_eq(u32view a, u32view b);
+
+/* positions where strings of equal length differ, -1 if the lengths differ */
+long hamming(u32view a, u32view b);
+/* differing bits of two blobs of equal size, -1 if the sizes differ */
+long long hamming_bits(const void *a, size_t la, const void *b, size_t lb);
+
+/* kernels in use: "generic", "sse4.2", "avx2" or "avx512" */
+const char *isa();
+
+}
+
+#endif
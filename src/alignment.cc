@@ -0,0 +1,14 @@
+#include "alignment.h"
+#include "dispatch.h"
+
+local_alignment::local_alignment(const wchar_t* pattern, size_t m, const alignment_scoring& s)
+    : profile(kernels().local_alignment_profile(pattern, m, &s)) {
+}
+
+local_alignment::~local_alignment() {
+    kernels().local_alignment_free(profile);
+}
+
+int local_alignment::score(const wchar_t* text, size_t n) {
+    return kernels().local_alignment(profile, text, n);
+}
@@ -0,0 +1,22 @@
+#include <cstddef>
+
+struct alignment_scoring; /* dispatch.h */
+
+/*
+ * Smith-Waterman local alignment of one pattern against many texts: the
+ * score of the best matching region, affine gaps. The striped query
+ * profile of the pattern is built once, see kernels.inc.
+ */
+class local_alignment {
+  public:
+    local_alignment(const wchar_t* pattern, size_t m, const alignment_scoring& s);
+    ~local_alignment();
+
+    int score(const wchar_t* text, size_t n);
+
+  private:
+    local_alignment(const local_alignment&);
+    local_alignment& operator=(const local_alignment&);
+
+    void* profile;
+};
@@ -0,0 +1,120 @@
+#include "cluster.h"
+#include "dispatch.h"
+#include "dice.h"
+#include "jarowinkler.h"
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+
+using namespace std;
+
+static const double eps = 1e-9;
+
+void leader_clustering::clear() {
+    chars.clear();
+    offsets.assign(1, 0);
+}
+
+void leader_clustering::add(const wchar_t* s, size_t l) {
+    chars.insert(chars.end(), s, s + l);
+    offsets.push_back(chars.size());
+}
+
+void leader_clustering::run(vector<size_t>& leader) {
+    size_t n = size();
+    vector<size_t> order(n), leaders;
+    vector<const wchar_t*> ptrs, candidate_ptrs;
+    vector<size_t> lens, candidates, candidate_lens;
+    vector<double> scores;
+    vector<uint64_t> bigrams, member_bigrams;
+    vector<size_t> bigram_offsets(1, 0);
+    unsigned int k = metric == CLUSTER_LEVENSHTEIN ? (unsigned int)max(floor(threshold + eps), 0.0) : 0;
+
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (length(a) != length(b))
+            return length(a) > length(b);
+        int c = wmemcmp(str(a), str(b), length(a));
+        return c ? c < 0 : a < b;
+    });
+
+    leader.resize(n);
+    for (size_t o = 0; o < n; o++) {
+        size_t m = order[o], lm = length(m);
+        const wchar_t* s = str(m);
+        size_t best = n;
+        double best_score = 0;
+
+        /* an equal string is as close as it gets, whatever the metric makes of it (empty, one letter for dice) */
+        for (size_t j = leaders.size(); j-- > 0 && lens[j] == lm;)
+            if (!wmemcmp(ptrs[j], s, lm))
+                best = j;
+
+        if (best == n && metric == CLUSTER_JARO_WINKLER) {
+            /* jaro <= (2 + shorter / longer) / 3, the prefix adds at most 0.4 of what is missing */
+            candidates.clear();
+            for (size_t j = 0; j < leaders.size(); j++) {
+                double jaro = lm ? (2.0 + (double)lm / lens[j]) / 3 : 0;
+                if (0.6 * jaro + 0.4 >= threshold - eps)
+                    candidates.push_back(j);
+            }
+            candidate_ptrs.clear();
+            candidate_lens.clear();
+            for (size_t i = 0; i < candidates.size(); i++) {
+                candidate_ptrs.push_back(ptrs[candidates[i]]);
+                candidate_lens.push_back(lens[candidates[i]]);
+            }
+            scores.resize(candidates.size());
+            if (!candidates.empty())
+                jaro_winkler_dist_many(s, lm, candidate_ptrs.data(), candidate_lens.data(), candidates.size(), scores.data());
+            for (size_t i = 0; i < candidates.size(); i++)
+                if (scores[i] >= threshold - eps && (best == n || scores[i] > best_score)) {
+                    best = candidates[i];
+                    best_score = scores[i];
+                }
+        } else if (best == n && metric == CLUSTER_LEVENSHTEIN) {
+            /* leaders are at least as long, a longer one costs the difference; every hit lowers the bound */
+            unsigned int bound = k;
+            for (size_t j = 0; j < leaders.size(); j++) {
+                if (lens[j] - lm > bound)
+                    continue;
+                unsigned int d = kernels().levenshtein_bounded(ptrs[j], lens[j], s, lm, bound);
+                if (d > bound)
+                    continue;
+                best = j;
+                if (!d)
+                    break;
+                bound = d - 1;
+            }
+        } else if (best == n) {
+            /* dice <= 2 * smaller / (sum of the bigram counts) */
+            dice_bigrams(s, lm, member_bigrams);
+            size_t nm = member_bigrams.size();
+            for (size_t j = 0; j < leaders.size(); j++) {
+                size_t nl = bigram_offsets[j + 1] - bigram_offsets[j];
+                if (!nm || !nl || 2.0 * min(nm, nl) / (nm + nl) < max(threshold, best_score) - eps)
+                    continue;
+                size_t common = kernels().intersect(member_bigrams.data(), nm, &bigrams[bigram_offsets[j]], nl);
+                double score = 2.0 * common / (nm + nl);
+                if (score >= threshold - eps && (best == n || score > best_score)) {
+                    best = j;
+                    best_score = score;
+                }
+            }
+        }
+
+        if (best < n) {
+            leader[m] = leaders[best];
+            continue;
+        }
+        leader[m] = m;
+        leaders.push_back(m);
+        ptrs.push_back(s);
+        lens.push_back(lm);
+        if (metric == CLUSTER_DICE) {
+            bigrams.insert(bigrams.end(), member_bigrams.begin(), member_bigrams.end());
+            bigram_offsets.push_back(bigrams.size());
+        }
+    }
+}
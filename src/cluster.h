@@ -0,0 +1,35 @@
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+enum cluster_metric { CLUSTER_JARO_WINKLER, CLUSTER_LEVENSHTEIN, CLUSTER_DICE };
+
+/*
+ * Leader clustering of a group of strings. Members are taken longest first
+ * (then in code point order, so the result doesn't depend on the order
+ * they were added in) and join the most similar leader within the
+ * threshold: jaro_winkler or dice at least it, levenshtein at most it.
+ * A member close to no leader becomes one. Leaders that can't reach the
+ * threshold by their length (or bigram count for dice) are skipped before
+ * any kernel runs.
+ */
+class leader_clustering {
+  public:
+    leader_clustering(cluster_metric metric, double threshold) : metric(metric), threshold(threshold) { clear(); }
+
+    void clear();
+    void add(const wchar_t* s, size_t l);
+    size_t size() const { return offsets.size() - 1; }
+
+    /* leader[i] is the member that represents member i, itself for a leader */
+    void run(std::vector<size_t>& leader);
+
+  private:
+    const wchar_t* str(size_t i) const { return chars.data() + offsets[i]; }
+    size_t length(size_t i) const { return offsets[i + 1] - offsets[i]; }
+
+    cluster_metric metric;
+    double threshold;
+    std::vector<wchar_t> chars;
+    std::vector<size_t> offsets;
+};
@@ -6,24 +6,98 @@
  */
 
 #include "dice.h"
-#include <set>
+#include "dispatch.h"
+#include <vector>
 #include <algorithm>
+#include <cstring>
 
 using namespace std;
 
+void dice_bigrams(const wchar_t* s, size_t l, vector<uint64_t>& bi) {
+    bi.clear();
+    bi.reserve(l);
+    for (size_t i = 0; i + 1 < l; i++)
+        bi.push_back(((uint64_t)(uint32_t)s[i] << 32) | (uint32_t)s[i + 1]);
+    sort(bi.begin(), bi.end());
+    bi.erase(unique(bi.begin(), bi.end()), bi.end());
+}
+
+double dice_coeff(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2, vector<uint64_t>& s1bi, vector<uint64_t>& s2bi) {
+    if (l1 == 0 || l2 == 0)
+        return 0;
+    dice_bigrams(s1, l1, s1bi);
+    dice_bigrams(s2, l2, s2bi);
+
+    size_t intersection = kernels().intersect(s1bi.data(), s1bi.size(), s2bi.data(), s2bi.size());
+
+    return (double)(intersection * 2) / (double)(s1bi.size() + s2bi.size());
+}
+
 double dice_coeff(const wstring& s1, const wstring& s2) {
-    set<wstring> s1bi, s2bi;
-    
-    if (s1.length() == 0 || s2.length() == 0)
+    vector<uint64_t> s1bi, s2bi;
+
+    return dice_coeff(s1.data(), s1.length(), s2.data(), s2.length(), s1bi, s2bi);
+}
+
+static void byte_bigrams(const unsigned char* s, size_t l, vector<uint64_t>& bi) {
+    bi.clear();
+    bi.reserve(l);
+    for (size_t i = 0; i + 1 < l; i++)
+        bi.push_back(((uint64_t)s[i] << 32) | s[i + 1]);
+    sort(bi.begin(), bi.end());
+    bi.erase(unique(bi.begin(), bi.end()), bi.end());
+}
+
+double dice_coeff_bytes(const char* s1, size_t l1, const char* s2, size_t l2, vector<uint64_t>& s1bi, vector<uint64_t>& s2bi) {
+    if (l1 == 0 || l2 == 0)
         return 0;
-    for (unsigned int i = 0; i < (s1.length() - 1); i++)
-        s1bi.insert(s1.substr(i, 2));
-    for (unsigned int i = 0; i < (s2.length() - 1); i++) 
-        s2bi.insert(s2.substr(i, 2));
+    byte_bigrams((const unsigned char*)s1, l1, s1bi);
+    byte_bigrams((const unsigned char*)s2, l2, s2bi);
 
-    int intersection = 0;
-    for (set<wstring>::iterator it = s2bi.begin(); it != s2bi.end(); ++it)
-        intersection += s1bi.count(*it);
+    size_t intersection = kernels().intersect(s1bi.data(), s1bi.size(), s2bi.data(), s2bi.size());
 
     return (double)(intersection * 2) / (double)(s1bi.size() + s2bi.size());
 }
+
+double dice_coeff_bytes(const char* s1, size_t l1, const char* s2, size_t l2) {
+    vector<uint64_t> s1bi, s2bi;
+
+    return dice_coeff_bytes(s1, l1, s2, l2, s1bi, s2bi);
+}
+
+void dice_profile(const wchar_t* s, size_t l, string& blob) {
+    vector<uint64_t> bi;
+
+    if (l == 1) {
+        uint32_t c = s[0];
+        blob.assign((const char*)&c, sizeof(c));
+        return;
+    }
+    dice_bigrams(s, l, bi);
+    blob.assign((const char*)bi.data(), bi.size() * sizeof(uint64_t));
+}
+
+/* the words of a profile, in place when aligned */
+static const uint64_t* profile_words(const char* p, size_t n, uint64_t* copy) {
+    if (!((uintptr_t)p & (sizeof(uint64_t) - 1)))
+        return (const uint64_t*)p;
+    memcpy(copy, p, n * sizeof(uint64_t));
+    return copy;
+}
+
+double dice_profile_coeff(const char* p1, size_t l1, const char* p2, size_t l2, vector<uint64_t>& scratch) {
+    if ((l1 % sizeof(uint64_t) && l1 != sizeof(uint32_t)) || (l2 % sizeof(uint64_t) && l2 != sizeof(uint32_t)))
+        return -1;
+    if (l1 == 0 || l2 == 0)
+        return 0;
+
+    size_t n1 = l1 / sizeof(uint64_t), n2 = l2 / sizeof(uint64_t);
+    if (scratch.size() < n1 + n2)
+        scratch.resize(n1 + n2);
+    const uint64_t* a = profile_words(p1, n1, scratch.data());
+    const uint64_t* b = profile_words(p2, n2, scratch.data() + n1);
+
+    size_t intersection = kernels().intersect(a, n1, b, n2);
+
+    return (double)(intersection * 2) / (double)(n1 + n2);
+}
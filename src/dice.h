@@ -1,3 +1,29 @@
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 double dice_coeff(const std::wstring& s1, const std::wstring& s2);
+
+/* the same over views, the bigrams go to the caller's buffers */
+double dice_coeff(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2, std::vector<uint64_t>& bi1, std::vector<uint64_t>& bi2);
+
+/* distinct bigrams of s packed two code points to a word, sorted; what dice_coeff compares */
+void dice_bigrams(const wchar_t* s, size_t l, std::vector<uint64_t>& bi);
+
+/*
+ * Stored form of the bigrams of s: the words of dice_bigrams in native byte
+ * order, or the code point alone (4 bytes) for a string of one character,
+ * which has no bigram but is not empty either.
+ */
+void dice_profile(const wchar_t* s, size_t l, std::string& blob);
+
+/*
+ * dice_coeff of the strings two profiles were made from, without decoding.
+ * Profiles not aligned to 8 bytes are copied to scratch first. Returns -1
+ * for a blob that can't be a profile.
+ */
+double dice_profile_coeff(const char* p1, size_t l1, const char* p2, size_t l2, std::vector<uint64_t>& scratch);
+
+/* dice_coeff of single-byte text (latin1, or UTF-8 that is all ASCII), bigrams packed the same way */
+double dice_coeff_bytes(const char* s1, size_t l1, const char* s2, size_t l2);
+double dice_coeff_bytes(const char* s1, size_t l1, const char* s2, size_t l2, std::vector<uint64_t>& bi1, std::vector<uint64_t>& bi2);
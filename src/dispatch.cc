@@ -0,0 +1,45 @@
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace kernels_generic { extern const kernel_table table; }
+#if defined(__x86_64__) || defined(__i386__)
+namespace kernels_sse42 { extern const kernel_table table; }
+namespace kernels_avx2 { extern const kernel_table table; }
+namespace kernels_avx512 { extern const kernel_table table; }
+#endif
+
+static const kernel_table *select_kernels() {
+    const kernel_table *supported[4];
+    unsigned int n = 0;
+
+    supported[n++] = &kernels_generic::table;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        supported[n++] = &kernels_sse42::table;
+    if (n == 2 && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2"))
+        supported[n++] = &kernels_avx2::table;
+    if (n == 3 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq"))
+        supported[n++] = &kernels_avx512::table;
+#endif
+
+    /* a level above what the cpu has is ignored */
+    const char *forced = getenv("MYMETRICS_ISA");
+    if (forced)
+        for (unsigned int i = 0; i < n; i++)
+            if (!strcmp(forced, supported[i]->name))
+                return supported[i];
+
+    return supported[n - 1];
+}
+
+const kernel_table& kernels() {
+    static const kernel_table *selected = select_kernels();
+    return *selected;
+}
+
+/* choose when the library is loaded, not on the first call */
+static const kernel_table& loaded = kernels();
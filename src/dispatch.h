@@ -0,0 +1,55 @@
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * Hot kernels compiled once per instruction set level (kernels_*.cc all
+ * include kernels.inc). The best table the cpu supports is chosen once when
+ * the library is loaded, MYMETRICS_ISA=generic|sse4.2|avx2|avx512 in the
+ * environment of the server forces a lower level.
+ */
+/* local alignment scores: match is added, the others subtracted; a gap of n costs gap_open + (n - 1) * gap_extend */
+struct alignment_scoring {
+    int match, mismatch, gap_open, gap_extend;
+};
+
+struct kernel_table {
+    const char *name;
+    /* edit distance */
+    unsigned int (*levenshtein)(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2);
+    /* edit distance if at most k, k + 1 otherwise */
+    unsigned int (*levenshtein_bounded)(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2, unsigned int k);
+    /* Jaro similarity without the Winkler prefix bonus */
+    double (*jaro)(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2);
+    /*
+     * levenshtein and jaro of q (as s1) against each of n candidates,
+     * out[i] for c[i]: the same values as n single calls
+     */
+    void (*levenshtein_many)(const wchar_t *q, size_t lq, const wchar_t *const *c, const size_t *lc, size_t n, unsigned int *out);
+    void (*jaro_many)(const wchar_t *q, size_t lq, const wchar_t *const *c, const size_t *lc, size_t n, double *out);
+    /* size of intersection of two strictly increasing arrays */
+    size_t (*intersect)(const uint64_t *a, size_t na, const uint64_t *b, size_t nb);
+    /* decodes l bytes of UTF-8 to out (room for l code points), invalid bytes give U+FFFD */
+    size_t (*utf8_decode)(const char *s, size_t l, wchar_t *out);
+    /* levenshtein, levenshtein_bounded and jaro of single-byte text, a byte is a character */
+    unsigned int (*levenshtein_bytes)(const char *s1, size_t l1, const char *s2, size_t l2);
+    unsigned int (*levenshtein_bytes_bounded)(const char *s1, size_t l1, const char *s2, size_t l2, unsigned int k);
+    double (*jaro_bytes)(const char *s1, size_t l1, const char *s2, size_t l2);
+    /* whether no byte has the high bit set */
+    bool (*is_ascii)(const char *s, size_t l);
+    /* positions where strings of n code points or bytes differ */
+    size_t (*hamming)(const wchar_t *a, const wchar_t *b, size_t n);
+    size_t (*hamming_bytes)(const char *a, const char *b, size_t n);
+    /* bits that differ between two blobs of n bytes */
+    uint64_t (*hamming_bits)(const char *a, const char *b, size_t n);
+    /*
+     * Smith-Waterman score of the best local alignment of a pattern in a
+     * text. The profile of the pattern is built once and used for any
+     * number of texts, by one thread at a time (it holds the work columns).
+     * Scores need 1 <= gap_extend <= gap_open and values below 1000.
+     */
+    void *(*local_alignment_profile)(const wchar_t *pattern, size_t m, const alignment_scoring *s);
+    int (*local_alignment)(void *profile, const wchar_t *text, size_t n);
+    void (*local_alignment_free)(void *profile);
+};
+
+const kernel_table& kernels();
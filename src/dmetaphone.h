@@ -1,6 +1,45 @@
 #include <vector>
 #include <string>
+#include <stdint.h>
 
 std::vector<std::wstring> dmetaphone(const std::wstring &str);
 
 int dmetaphone_eq(const std::wstring &s1, const std::wstring &s2);
+
+/*
+  Codes of str cut to n symbols (at most 32, as dmetaphone() keeps), the
+  word is only encoded as far as that takes.
+*/
+void dmetaphone_prefix(const std::wstring &str, size_t n, std::wstring &primary, std::wstring &secondary);
+
+/*
+  First 12 symbols of a code packed 5 bits each, the first one highest, so
+  keys order like the codes and an empty code is 0. Longer codes share the
+  key of their first 12 symbols.
+*/
+const unsigned int dmetaphone_key_symbols = 12;
+uint64_t dmetaphone_key(const std::wstring &code);
+
+/*
+  Resumable encoder behind dmetaphone(): every step() handles the letter at
+  the current position (sometimes a few) and appends what it emits to both
+  codes. It returns false once the codes are complete; they are not cut to
+  max_length here.
+*/
+class dmetaphone_encoder {
+ public:
+  explicit dmetaphone_encoder(const std::wstring &str);
+  bool step();
+
+  std::wstring primary;
+  std::wstring secondary;
+
+ private:
+  std::wstring original;
+  int length;
+  int last;
+  int current;
+  int slavo_germanic;  /* -1 until is_slavo_germanic() first looks */
+
+  bool is_slavo_germanic();
+};
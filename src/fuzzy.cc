@@ -0,0 +1,122 @@
+#include "fuzzy.h"
+#include <algorithm>
+
+using namespace std;
+
+void fuzzy_pattern::assign(const wchar_t* p, size_t lp) {
+    pattern.assign(p, lp);
+    forward.assign(p, lp, false);
+    /* only position() needs the reversed pattern */
+    backward_ready = false;
+}
+
+void fuzzy_pattern::bit_masks::assign(const wchar_t* p, size_t lp, bool reversed) {
+    m = lp;
+    blocks = max((size_t)1, (lp + 63) / 64);
+    low.assign(256 * blocks, 0);
+
+    bits = 4;
+    while ((1U << bits) < 2 * lp)
+        bits++;
+    keys.assign(1U << bits, 0);
+    high.assign((size_t)(1U << bits) * blocks + blocks, 0);
+
+    for (size_t i = 0; i < lp; i++) {
+        wchar_t c = reversed ? p[lp - 1 - i] : p[i];
+        uint64_t bit = 1ULL << (i % 64);
+        if ((uint32_t)c < 256) {
+            low[(uint32_t)c * blocks + i / 64] |= bit;
+            continue;
+        }
+        unsigned int h = ((uint32_t)c * 0x9E3779B1U) >> (32 - bits);
+        while (keys[h] && keys[h] != c)
+            h = (h + 1) & ((1U << bits) - 1);
+        keys[h] = c;
+        high[h * blocks + i / 64] |= bit;
+    }
+    pv.resize(blocks);
+    mv.resize(blocks);
+}
+
+/* masks of c, one word per block; the spare block after the table is all zero */
+const uint64_t* fuzzy_pattern::bit_masks::of(wchar_t c) const {
+    if ((uint32_t)c < 256)
+        return &low[(uint32_t)c * blocks];
+    for (unsigned int h = ((uint32_t)c * 0x9E3779B1U) >> (32 - bits); keys[h]; h = (h + 1) & ((1U << bits) - 1))
+        if (keys[h] == c)
+            return &high[h * blocks];
+    return &high[(size_t)(1U << bits) * blocks];
+}
+
+/*
+ * Characters of t read (from the end when reversed) until the last row of
+ * the DP gets to k or below, -1 if it never does. Unanchored the top row is
+ * all zero, a match starts anywhere; anchored it counts the characters
+ * read, the match starts at the first one. m > k.
+ */
+long fuzzy_pattern::bit_masks::scan(const wchar_t* t, size_t n, bool reversed, bool anchored, unsigned int k) {
+    const uint64_t last_bit = 1ULL << ((m - 1) % 64);
+    unsigned int score = m;
+
+    fill(pv.begin(), pv.end(), ~0ULL);
+    fill(mv.begin(), mv.end(), 0);
+
+    for (size_t j = 0; j < n; j++) {
+        const uint64_t* eq = of(reversed ? t[n - 1 - j] : t[j]);
+        /* horizontal step into the top of the block: +1 anchored (row 0 is j), 0 free */
+        int carry = anchored;
+
+        for (size_t b = 0; b < blocks; b++) {
+            uint64_t p = pv[b], q = mv[b], e = eq[b];
+            uint64_t xv = e | q;
+            if (carry < 0)
+                e |= 1;
+            uint64_t xh = (((e & p) + p) ^ p) | e;
+            uint64_t ph = q | ~(xh | p);
+            uint64_t mh = p & xh;
+            uint64_t high_bit = b + 1 == blocks ? last_bit : 1ULL << 63;
+            int out = (ph & high_bit) ? 1 : (mh & high_bit) ? -1 : 0;
+
+            ph <<= 1;
+            mh <<= 1;
+            if (carry < 0)
+                mh |= 1;
+            else if (carry > 0)
+                ph |= 1;
+            pv[b] = mh | ~(xv | ph);
+            mv[b] = ph & xv;
+            carry = out;
+        }
+        score += carry;
+        if (score <= k)
+            return j + 1;
+    }
+    return -1;
+}
+
+bool fuzzy_pattern::contains(const wchar_t* t, size_t n, int k) {
+    if (k < 0)
+        return false;
+    if (pattern.size() <= (size_t)k)
+        return true;
+    return forward.scan(t, n, false, false, k) >= 0;
+}
+
+size_t fuzzy_pattern::position(const wchar_t* t, size_t n, int k) {
+    if (k < 0)
+        return 0;
+    if (pattern.size() <= (size_t)k)
+        return 1;
+
+    long end = forward.scan(t, n, false, false, k);
+    if (end < 0)
+        return 0;
+
+    /* back from the end: the reversed pattern against the text before it, anchored there */
+    if (!backward_ready) {
+        backward.assign(pattern.data(), pattern.size(), true);
+        backward_ready = true;
+    }
+    long length = backward.scan(t, end, true, true, k);
+    return end - length + 1;
+}
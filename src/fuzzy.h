@@ -0,0 +1,47 @@
+#include <cwchar>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Approximate search of one pattern in many texts (Myers, "A fast
+ * bit-vector algorithm for approximate string matching based on dynamic
+ * programming", JACM 1999). The DP column of the pattern against the text,
+ * where a match may start anywhere, is kept as +1/-1 bit vectors of 64
+ * cells a word: one pass over the text, ceil(m / 64) words per character.
+ * Masks are built once per pattern and reused for every text.
+ */
+class fuzzy_pattern {
+  public:
+    fuzzy_pattern() {}
+    fuzzy_pattern(const wchar_t* p, size_t lp) { assign(p, lp); }
+    void assign(const wchar_t* p, size_t lp);
+
+    /* whether t has a substring within k edits of the pattern */
+    bool contains(const wchar_t* t, size_t n, int k);
+
+    /*
+     * 1-based position of the first substring of t within k edits of the
+     * pattern (the one that ends first, the shortest of those), 0 if none
+     */
+    size_t position(const wchar_t* t, size_t n, int k);
+
+  private:
+    /* match masks of a pattern, low code points directly, others hashed */
+    struct bit_masks {
+        size_t m, blocks;
+        std::vector<uint64_t> low;     /* 256 x blocks */
+        unsigned int bits;
+        std::vector<wchar_t> keys;     /* 0 for a free slot, hashed code points are never below 256 */
+        std::vector<uint64_t> high;    /* (1 << bits) x blocks */
+        std::vector<uint64_t> pv, mv;
+
+        void assign(const wchar_t* p, size_t lp, bool reversed);
+        const uint64_t* of(wchar_t c) const;
+        long scan(const wchar_t* t, size_t n, bool reversed, bool anchored, unsigned int k);
+    };
+
+    bit_masks forward, backward;
+    bool backward_ready;
+    std::wstring pattern;
+};
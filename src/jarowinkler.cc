@@ -18,65 +18,24 @@
  */
 
 #include "jarowinkler.h"
+#include "dispatch.h"
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
-#define MAX(a,b) ((a) > (b) ? (a) : (b))
-
-double jaro_winkler_dist(const wchar_t *s1, const wchar_t *s2, double scaling_factor) {
-    int i, j, l;
-    int m = 0, t = 0;
-    int s1l = wcslen(s1);
-    int s2l = wcslen(s2);
-    int s1flags[s1l], s2flags[s2l];
-    int range = MAX(0, MAX(s1l, s2l) / 2 - 1);
-    double dw;
-
-    if (!s1l || !s2l)
-        return 0.0;
 
-    for (i = 0; i < s2l; i++)
-        s2flags[i] = 0;
-
-    for (i = 0; i < s1l; i++)
-        s1flags[i] = 0;
-
-    /* calculate matching characters */
-    for (i = 0; i < s2l; i++) {
-        for (j = MAX(i - range, 0), l = MIN(i + range + 1, s1l); j < l; j++) {
-            if (s2[i] == s1[j] && !s1flags[j]) {
-                s1flags[j] = 1;
-                s2flags[i] = 1;
-                m++;
-                break;
-            }
-        }
-    }
+static double jaro_winkler_dist(const wchar_t *s1, size_t s1l, const wchar_t *s2, size_t s2l, size_t prefix, double scaling_factor) {
+    size_t i, n;
+    int l;
+    double dw;
 
-    if (!m)
+    /* Jaro distance, matching and transpositions are in kernels.inc */
+    dw = kernels().jaro(s1, s1l, s2, s2l);
+    if (dw == 0.0)
         return 0.0;
 
-    /* calculate character transpositions */
-    l = 0;
-    for (i = 0; i < s2l; i++) {
-        if (s2flags[i] == 1) {
-            for (j = l; j < s1l; j++) {
-                if (s1flags[j] == 1) {
-                    l = j + 1;
-                    break;
-                }
-            }
-            if (s2[i] != s1[j])
-                t++;
-        }
-    }
-    t /= 2;
-
-    /* Jaro distance */
-    dw = (((double)m / s1l) + ((double)m / s2l) + ((double)(m - t) / m)) / 3.0;
-
-    /* calculate common string prefix up to 4 chars */
-    l = 0;
-    for (i = 0; i < MIN(MIN(s1l, s2l), 4); i++)
+    /* calculate common string prefix up to 4 chars, the first prefix chars are known to match */
+    n = MIN(MIN(s1l, s2l), 4);
+    l = MIN(prefix, n);
+    for (i = l; i < n; i++)
         if (s1[i] == s2[i])
             l++;
 
@@ -86,6 +45,47 @@ double jaro_winkler_dist(const wchar_t *s1, const wchar_t *s2, double scaling_fa
     return dw;
 }
 
+double jaro_winkler_dist(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2) {
+    return jaro_winkler_dist(s1, l1, s2, l2, 0, 0.1);
+}
+
+double jaro_winkler_dist(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2, size_t prefix) {
+    return jaro_winkler_dist(s1, l1, s2, l2, prefix, 0.1);
+}
+
 double jaro_winkler_dist(const wchar_t *s1, const wchar_t *s2) {
-    return jaro_winkler_dist(s1, s2, 0.1);
+    return jaro_winkler_dist(s1, wcslen(s1), s2, wcslen(s2), 0, 0.1);
+}
+
+void jaro_winkler_dist_many(const wchar_t *q, size_t lq, const wchar_t *const *c, const size_t *lc, size_t n, double *out) {
+    size_t i;
+    int j, l;
+
+    kernels().jaro_many(q, lq, c, lc, n, out);
+    for (i = 0; i < n; i++) {
+        if (out[i] == 0.0)
+            continue;
+        l = 0;
+        for (j = 0; j < (int)MIN(MIN(lq, lc[i]), 4); j++)
+            if (q[j] == c[i][j])
+                l++;
+        out[i] = out[i] + (l * 0.1 * (1 - out[i]));
+    }
+}
+
+/* jaro_winkler_dist of single-byte text, see kernels().jaro_bytes */
+double jaro_winkler_bytes(const char *s1, size_t s1l, const char *s2, size_t s2l) {
+    size_t i;
+    int l;
+    double dw = kernels().jaro_bytes(s1, s1l, s2, s2l);
+
+    if (dw == 0.0)
+        return 0.0;
+
+    l = 0;
+    for (i = 0; i < MIN(MIN(s1l, s2l), 4); i++)
+        if (s1[i] == s2[i])
+            l++;
+
+    return dw + (l * 0.1 * (1 - dw));
 }
@@ -1,3 +1,12 @@
 #include <cwchar>
 
 double jaro_winkler_dist(const wchar_t *s1, const wchar_t *s2);
+double jaro_winkler_dist(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2);
+/* the same when the first prefix characters are already known to be equal */
+double jaro_winkler_dist(const wchar_t *s1, size_t l1, const wchar_t *s2, size_t l2, size_t prefix);
+
+/* jaro_winkler_dist(q, c[i]) for each of n candidates of length lc[i] into out[i] */
+void jaro_winkler_dist_many(const wchar_t *q, size_t lq, const wchar_t *const *c, const size_t *lc, size_t n, double *out);
+
+/* the same over single-byte text (latin1, or UTF-8 that is all ASCII) */
+double jaro_winkler_bytes(const char *s1, size_t l1, const char *s2, size_t l2);
@@ -0,0 +1,13 @@
+/* kernels for Haswell and newer (AVX2, BMI2) */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+#pragma GCC target("avx2,bmi,bmi2,popcnt")
+#define KERNEL_NS kernels_avx2
+#define KERNEL_NAME "avx2"
+#include "kernels.inc"
+#endif
@@ -0,0 +1,13 @@
+/* kernels for Skylake-SP and newer (AVX-512 F/BW/VL/DQ) */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+#pragma GCC target("avx512f,avx512bw,avx512vl,avx512dq,avx2,bmi,bmi2,popcnt")
+#define KERNEL_NS kernels_avx512
+#define KERNEL_NAME "avx512"
+#include "kernels.inc"
+#endif
@@ -0,0 +1,9 @@
+/* kernels for any cpu, the baseline of the compiler target */
+
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+
+#define KERNEL_NS kernels_generic
+#define KERNEL_NAME "generic"
+#include "kernels.inc"
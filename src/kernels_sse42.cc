@@ -0,0 +1,13 @@
+/* kernels for Nehalem and newer (SSE4.2, POPCNT) */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include "dispatch.h"
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+#pragma GCC target("sse4.2,popcnt")
+#define KERNEL_NS kernels_sse42
+#define KERNEL_NAME "sse4.2"
+#include "kernels.inc"
+#endif
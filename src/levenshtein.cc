@@ -1,21 +1,173 @@
 #include "levenshtein.h"
+#include "dispatch.h"
+#include <algorithm>
 
-#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
-
+/* bit-parallel for strings up to 64 characters, vectorised anti-diagonal DP above, see kernels.inc */
 int levenshtein_dist(const wchar_t* s1, const wchar_t* s2) {
-    unsigned int s1len, s2len, x, y, lastdiag, olddiag;
-    s1len = wcslen(s1);
-    s2len = wcslen(s2);
-    unsigned int column[s1len+1];
-    for (y = 1; y <= s1len; y++)
-        column[y] = y;
-    for (x = 1; x <= s2len; x++) {
-        column[0] = x;
-        for (y = 1, lastdiag = x-1; y <= s1len; y++) {
-            olddiag = column[y];
-            column[y] = MIN3(column[y] + 1, column[y-1] + 1, lastdiag + (s1[y-1] == s2[x-1] ? 0 : 1));
-            lastdiag = olddiag;
+    return kernels().levenshtein(s1, wcslen(s1), s2, wcslen(s2));
+}
+
+int levenshtein_dist(const wchar_t* s1, const wchar_t* s2, int max_dist) {
+    return kernels().levenshtein_bounded(s1, wcslen(s1), s2, wcslen(s2), max_dist);
+}
+
+int levenshtein_dist(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2) {
+    return kernels().levenshtein(s1, l1, s2, l2);
+}
+
+int levenshtein_dist(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2, int max_dist) {
+    return kernels().levenshtein_bounded(s1, l1, s2, l2, max_dist);
+}
+
+void levenshtein_dist_many(const wchar_t* q, size_t lq, const wchar_t* const* c, const size_t* lc, size_t n, unsigned int* out) {
+    kernels().levenshtein_many(q, lq, c, lc, n, out);
+}
+
+levenshtein_stream::levenshtein_stream(const wchar_t* q, size_t lq) : query(q, lq), valid(0) {
+    if (lq > 64) {
+        cells.resize(lq + 1);
+        for (size_t i = 0; i <= lq; i++)
+            cells[i] = i;
+        return;
+    }
+
+    for (size_t c = 0; c < 256; c++)
+        low[c] = 0;
+    /* others in an open addressing table of at least twice the query */
+    bits = 4;
+    while ((1U << bits) < 2 * lq)
+        bits++;
+    for (size_t h = 0; h < (1U << bits); h++)
+        masks[h] = 0;
+    for (size_t i = 0; i < lq; i++) {
+        if ((uint32_t)q[i] < 256) {
+            low[(uint32_t)q[i]] |= 1ULL << i;
+            continue;
         }
+        unsigned int h = slot(q[i]);
+        while (masks[h] && keys[h] != q[i])
+            h = (h + 1) & ((1U << bits) - 1);
+        keys[h] = q[i];
+        masks[h] |= 1ULL << i;
+    }
+
+    pv.assign(1, ~0ULL);
+    mv.assign(1, 0);
+    score.assign(1, lq);
+}
+
+unsigned int levenshtein_stream::slot(wchar_t c) const {
+    return ((uint32_t)c * 0x9E3779B1U) >> (32 - bits);
+}
+
+uint64_t levenshtein_stream::mask_of(wchar_t c) const {
+    if ((uint32_t)c < 256)
+        return low[(uint32_t)c];
+    for (unsigned int h = slot(c); masks[h]; h = (h + 1) & ((1U << bits) - 1))
+        if (keys[h] == c)
+            return masks[h];
+    return 0;
+}
+
+/* cell of column j in the last row, the distance to the first j characters */
+unsigned int levenshtein_stream::last_row(size_t j) const {
+    size_t m = query.size();
+    return m > 64 ? cells[j * (m + 1) + m] : score[j];
+}
+
+/* whether every cell of column j is above k */
+bool levenshtein_stream::column_above(size_t j, unsigned int k) const {
+    size_t m = query.size();
+
+    /* the top cell is j, the bottom one the distance so far */
+    if (j <= k || last_row(j) <= k)
+        return false;
+
+    if (m > 64) {
+        const unsigned int* col = &cells[j * (m + 1)];
+        return *std::min_element(col, col + m + 1) > k;
+    }
+
+    /* pv/mv bits are steps of +1/-1 down the column */
+    uint64_t used = m == 64 ? ~0ULL : (1ULL << m) - 1;
+    uint64_t up = pv[j] & used, down = mv[j] & used;
+    if ((int)j - __builtin_popcountll(down) > (int)k || (int)score[j] - __builtin_popcountll(up) > (int)k)
+        return true;
+
+    int cell = j;
+    for (uint64_t steps = up | down; steps; steps &= steps - 1) {
+        cell += (up >> __builtin_ctzll(steps)) & 1 ? 1 : -1;
+        if (cell <= (int)k)
+            return false;
+    }
+    return true;
+}
+
+/* column j from column j - 1 and character c of the candidate, room for it is reserved */
+void levenshtein_stream::step(size_t j, wchar_t c) {
+    size_t m = query.size();
+
+    if (m > 64) {
+        const unsigned int* prev = &cells[(j - 1) * (m + 1)];
+        unsigned int* col = &cells[j * (m + 1)];
+        col[0] = j;
+        for (size_t i = 1; i <= m; i++)
+            col[i] = std::min(std::min(prev[i] + 1, col[i - 1] + 1), prev[i - 1] + (query[i - 1] != c));
+        return;
+    }
+
+    uint64_t p = pv[j - 1], n = mv[j - 1], last_bit = 1ULL << (m - 1);
+    uint64_t eq = mask_of(c);
+    uint64_t xv = eq | n;
+    uint64_t xh = (((eq & p) + p) ^ p) | eq;
+    uint64_t ph = n | ~(xh | p);
+    uint64_t mh = p & xh;
+
+    score[j] = score[j - 1] + ((ph & last_bit) != 0) - ((mh & last_bit) != 0);
+    ph = (ph << 1) | 1;
+    mh <<= 1;
+    pv[j] = mh | ~(xv | ph);
+    mv[j] = ph & xv;
+}
+
+unsigned int levenshtein_stream::distance(const wchar_t* c, size_t lc, int max_dist) {
+    size_t m = query.size(), j = 0;
+
+    if (!m)
+        return max_dist >= 0 && lc > (size_t)max_dist ? max_dist + 1 : lc;
+
+    /* past max_cells the DP matrix isn't kept, the kernels need only O(m) */
+    if (m > 64 && (lc + 1) * (m + 1) > max_cells) {
+        valid = 0;
+        last.clear();
+        if (max_dist >= 0)
+            return kernels().levenshtein_bounded(query.data(), m, c, lc, max_dist);
+        return kernels().levenshtein(query.data(), m, c, lc);
     }
-    return(column[s1len]);
+
+    /* columns of the shared prefix are still right */
+    size_t shared = std::min(std::min(valid, lc), last.size());
+    while (j < shared && c[j] == last[j])
+        j++;
+
+    last.assign(c, lc);
+    if (m > 64 && cells.size() < (lc + 1) * (m + 1))
+        cells.resize((lc + 1) * (m + 1));
+    if (m <= 64 && score.size() < lc + 1) {
+        pv.resize(lc + 1);
+        mv.resize(lc + 1);
+        score.resize(lc + 1);
+    }
+    for (;; j++) {
+        valid = j;
+        /* a cell above max_dist never comes back under it further right */
+        if (max_dist >= 0 && column_above(j, max_dist))
+            return max_dist + 1;
+        if (j == lc)
+            break;
+        step(j + 1, c[j]);
+    }
+
+    unsigned int d = last_row(lc);
+    return max_dist >= 0 && d > (unsigned int)max_dist ? max_dist + 1 : d;
 }
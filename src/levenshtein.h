@@ -1,3 +1,62 @@
 #include <cwchar>
+#include <string>
+#include <vector>
+#include <stdint.h>
 
 int levenshtein_dist(const wchar_t* s1, const wchar_t* s2);
+
+/* distance, or max_dist + 1 if it is larger; stops as soon as that is known */
+int levenshtein_dist(const wchar_t* s1, const wchar_t* s2, int max_dist);
+
+/* the same with the lengths known, the strings need no terminator */
+int levenshtein_dist(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2);
+int levenshtein_dist(const wchar_t* s1, size_t l1, const wchar_t* s2, size_t l2, int max_dist);
+
+/* distances of q to each of n candidates c[i] of length lc[i] into out[i] */
+void levenshtein_dist_many(const wchar_t* q, size_t lq, const wchar_t* const* c, const size_t* lc, size_t n, unsigned int* out);
+
+/*
+ * One query against a stream of candidates (a constant UDF argument against
+ * a column). The DP state after every character of the last candidate is
+ * kept, so the next one only goes through the characters after the prefix
+ * they share: a scan of sorted values does work in proportion to the
+ * distinct suffixes. Queries of up to 64 characters keep one Myers column
+ * (three words) per character, longer ones the full DP column as long as
+ * the matrix stays under max_cells; larger pairs are computed from scratch
+ * by the kernels.
+ */
+class levenshtein_stream {
+  public:
+    levenshtein_stream(const wchar_t* q, size_t lq);
+
+    /* cells of the matrix kept for queries over 64 characters, 4 MB */
+    static const size_t max_cells = 1 << 20;
+
+    /*
+     * distance to c; with max_dist >= 0, max_dist + 1 as soon as every cell
+     * of a column is above max_dist, the characters after it are not read
+     */
+    unsigned int distance(const wchar_t* c, size_t lc, int max_dist = -1);
+
+  private:
+    unsigned int slot(wchar_t c) const;
+    uint64_t mask_of(wchar_t c) const;
+    unsigned int last_row(size_t j) const;
+    bool column_above(size_t j, unsigned int k) const;
+    void step(size_t j, wchar_t c);
+
+    std::wstring query;
+    std::wstring last;    /* previous candidate, columns 1..valid of it are kept */
+    size_t valid;
+
+    /* Myers: masks of the query, low code points directly, others hashed */
+    uint64_t low[256];
+    unsigned int bits;
+    wchar_t keys[128];
+    uint64_t masks[128];
+    std::vector<uint64_t> pv, mv;
+    std::vector<unsigned int> score;
+
+    /* longer queries: column j at cells[j * (query.size() + 1)] */
+    std::vector<unsigned int> cells;
+};
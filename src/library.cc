@@ -0,0 +1,95 @@
+/*
+ * include/mymetrics/mymetrics.h over the kernels. UTF-8 strings that are
+ * all ASCII go to the byte kernels without decoding, like in the UDFs.
+ */
+
+#include "mymetrics/mymetrics.h"
+#include "dispatch.h"
+#include "levenshtein.h"
+#include "jarowinkler.h"
+#include "dice.h"
+#include "dmetaphone.h"
+
+using namespace std;
+
+namespace mymetrics {
+
+static bool ascii(utf8view a, utf8view b) {
+    return kernels().is_ascii(a.data, a.size) && kernels().is_ascii(b.data, b.size);
+}
+
+void decode(utf8view s, wstring &out) {
+    out.resize(s.size);
+    out.resize(kernels().utf8_decode(s.data, s.size, &out[0]));
+}
+
+unsigned int levenshtein(u32view a, u32view b) {
+    return kernels().levenshtein(a.data, a.size, b.data, b.size);
+}
+
+unsigned int levenshtein(u32view a, u32view b, unsigned int max_dist) {
+    return kernels().levenshtein_bounded(a.data, a.size, b.data, b.size, max_dist);
+}
+
+unsigned int levenshtein(utf8view a, utf8view b, scratch &s) {
+    if (ascii(a, b))
+        return kernels().levenshtein_bytes(a.data, a.size, b.data, b.size);
+    decode(a, s.a);
+    decode(b, s.b);
+    return levenshtein(s.a, s.b);
+}
+
+unsigned int levenshtein(utf8view a, utf8view b, unsigned int max_dist, scratch &s) {
+    if (ascii(a, b))
+        return kernels().levenshtein_bytes_bounded(a.data, a.size, b.data, b.size, max_dist);
+    decode(a, s.a);
+    decode(b, s.b);
+    return levenshtein(s.a, s.b, max_dist);
+}
+
+double jaro_winkler(u32view a, u32view b) {
+    return jaro_winkler_dist(a.data, a.size, b.data, b.size);
+}
+
+double jaro_winkler(utf8view a, utf8view b, scratch &s) {
+    if (ascii(a, b))
+        return jaro_winkler_bytes(a.data, a.size, b.data, b.size);
+    decode(a, s.a);
+    decode(b, s.b);
+    return jaro_winkler(s.a, s.b);
+}
+
+double dice(u32view a, u32view b, scratch &s) {
+    return dice_coeff(a.data, a.size, b.data, b.size, s.bigrams_a, s.bigrams_b);
+}
+
+double dice(utf8view a, utf8view b, scratch &s) {
+    if (ascii(a, b))
+        return dice_coeff_bytes(a.data, a.size, b.data, b.size, s.bigrams_a, s.bigrams_b);
+    decode(a, s.a);
+    decode(b, s.b);
+    return dice(s.a, s.b, s);
+}
+
+bool double_metaphone_eq(u32view a, u32view b) {
+    /* the encoder pads and upper-cases its own copy */
+    return dmetaphone_eq(wstring(a.data, a.size), wstring(b.data, b.size));
+}
+
+long hamming(u32view a, u32view b) {
+    if (a.size != b.size)
+        return -1;
+    return kernels().hamming(a.data, b.data, a.size);
+}
+
+long long hamming_bits(const void *a, size_t la, const void *b, size_t lb) {
+    if (la != lb)
+        return -1;
+    return kernels().hamming_bits((const char*)a, (const char*)b, la);
+}
+
+const char *isa() {
+    return kernels().name;
+}
+
+}
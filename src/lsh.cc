@@ -0,0 +1,103 @@
+/*
+ * Locality sensitive signatures over q-gram shingles for blocking.
+ *
+ * Shingles are the same q-grams dice_coeff takes for q = 2: every substring
+ * of q characters, deduplicated. A string shorter than q is a single shingle.
+ *
+ * MinHash uses the Kirsch-Mitzenmacher trick: shingle hash h gives
+ * g_i = mix(lo(h) + i * hi(h)) for every i, so all bands * rows minimums are
+ * updated by one flat 32-bit loop the compiler turns into vector code.
+ * Every band of rows minimums is folded to a 64-bit key, strings sharing a
+ * key are candidate pairs.
+ *
+ * SimHash sums +1/-1 per bit of each shingle hash, the sign gives the bit, so
+ * hamming distance between signatures approximates cosine distance of the
+ * shingle sets.
+ */
+
+#include "lsh.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+static inline uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/* sorted distinct hashes of q-gram shingles of s */
+static void shingles(const wstring& s, unsigned int q, vector<uint64_t>& out) {
+    size_t n = s.length();
+    size_t count = n < q ? 1 : n - q + 1;
+
+    if (!n)
+        return;
+
+    out.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t j = i; j < i + q && j < n; j++)
+            h = (h ^ (uint32_t)s[j]) * 1099511628211ULL;
+        out.push_back(fmix64(h));
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+void minhash_bands(const wstring& s, unsigned int q, unsigned int bands, uint64_t* keys) {
+    const unsigned int k = bands * minhash_rows;
+    uint32_t mins[minhash_max_bands * minhash_rows];
+    vector<uint64_t> hashes;
+
+    shingles(s, q, hashes);
+    for (unsigned int i = 0; i < k; i++)
+        mins[i] = 0xffffffffU;
+
+    for (size_t n = 0; n < hashes.size(); n++) {
+        uint32_t a = (uint32_t)hashes[n];
+        uint32_t b = (uint32_t)(hashes[n] >> 32) | 1;
+        for (unsigned int i = 0; i < k; i++) {
+            uint32_t g = fmix32(a + i * b);
+            mins[i] = g < mins[i] ? g : mins[i];
+        }
+    }
+
+    for (unsigned int band = 0; band < bands; band++) {
+        uint64_t h = band;
+        for (unsigned int r = 0; r < minhash_rows; r++)
+            h = fmix64(h ^ ((uint64_t)mins[band * minhash_rows + r] << 17));
+        keys[band] = h;
+    }
+}
+
+uint64_t simhash(const wstring& s, unsigned int q) {
+    int weights[64] = {0};
+    vector<uint64_t> hashes;
+    uint64_t sig = 0;
+
+    shingles(s, q, hashes);
+    for (size_t n = 0; n < hashes.size(); n++) {
+        uint64_t h = hashes[n];
+        for (unsigned int bit = 0; bit < 64; bit++)
+            weights[bit] += (int)((h >> bit) & 1) * 2 - 1;
+    }
+
+    for (unsigned int bit = 0; bit < 64; bit++)
+        if (weights[bit] > 0)
+            sig |= 1ULL << bit;
+    return sig;
+}
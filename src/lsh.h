@@ -0,0 +1,10 @@
+#include <string>
+#include <stdint.h>
+
+/* minhash values per band, minhash_sig returns one key per band */
+const unsigned int minhash_rows = 4;
+const unsigned int minhash_max_bands = 32;
+
+void minhash_bands(const std::wstring& s, unsigned int q, unsigned int bands, uint64_t* keys);
+
+uint64_t simhash(const std::wstring& s, unsigned int q);
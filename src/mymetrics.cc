@@ -29,12 +29,26 @@ typedef long long longlong;
 #include "dmetaphone.h"
 #include "jarowinkler.h"
 #include "dice.h"
+#include "tokens.h"
+#include "lsh.h"
+#include "fuzzy.h"
+#include "ruphonetic.h"
+#include "normalize.h"
+#include "alignment.h"
+#include "cluster.h"
+#include "dispatch.h"
 
 #include <clocale>
+#include <new>
 #include <cstdlib>
+#include <climits>
+#ifdef MYMETRICS_SELFTEST
+#undef NDEBUG
+#endif
 #include <cassert>
 #include <cmath>
 #include <mutex>
+#include <algorithm>
 
 using namespace std;
 
@@ -47,6 +61,22 @@ extern "C" {
   my_bool double_metaphone_eq_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
   void double_metaphone_eq_deinit(UDF_INIT *initid);
 
+  char *double_metaphone_primary(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool double_metaphone_primary_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void double_metaphone_primary_deinit(UDF_INIT *initid);
+
+  char *double_metaphone_secondary(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool double_metaphone_secondary_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void double_metaphone_secondary_deinit(UDF_INIT *initid);
+
+  longlong double_metaphone_key(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool double_metaphone_key_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void double_metaphone_key_deinit(UDF_INIT *initid);
+
+  char *ru_phonetic_key(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool ru_phonetic_key_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void ru_phonetic_key_deinit(UDF_INIT *initid);
+
   double jaro_winkler(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
   my_bool jaro_winkler_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
   void jaro_winkler_deinit(UDF_INIT *initid);
@@ -55,96 +85,1369 @@ extern "C" {
   my_bool dice_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
   void dice_deinit(UDF_INIT *initid);
 
+  char *dice_profile(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool dice_profile_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void dice_profile_deinit(UDF_INIT *initid);
+
+  double dice_profile_sim(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool dice_profile_sim_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void dice_profile_sim_deinit(UDF_INIT *initid);
+
+  double token_jaccard(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool token_jaccard_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void token_jaccard_deinit(UDF_INIT *initid);
+
+  double token_sort_ratio(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool token_sort_ratio_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void token_sort_ratio_deinit(UDF_INIT *initid);
+
+  double token_set_ratio(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool token_set_ratio_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void token_set_ratio_deinit(UDF_INIT *initid);
+
+  longlong fuzzy_contains(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool fuzzy_contains_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void fuzzy_contains_deinit(UDF_INIT *initid);
+
+  longlong fuzzy_position(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool fuzzy_position_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void fuzzy_position_deinit(UDF_INIT *initid);
+
+  longlong local_alignment_score(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool local_alignment_score_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void local_alignment_score_deinit(UDF_INIT *initid);
+
+  longlong hamming(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool hamming_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void hamming_deinit(UDF_INIT *initid);
+
+  longlong hamming_bits(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool hamming_bits_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void hamming_bits_deinit(UDF_INIT *initid);
+
+  char *minhash_sig(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool minhash_sig_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void minhash_sig_deinit(UDF_INIT *initid);
+
+  longlong simhash64(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+  my_bool simhash64_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void simhash64_deinit(UDF_INIT *initid);
+
+  char *string_similarity(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool string_similarity_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void string_similarity_deinit(UDF_INIT *initid);
+
+  char *fuzzy_cluster(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool fuzzy_cluster_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void fuzzy_cluster_deinit(UDF_INIT *initid);
+  void fuzzy_cluster_clear(UDF_INIT *initid, char *is_null, char *error);
+  void fuzzy_cluster_add(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
+  char *mymetrics_isa(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error);
+  my_bool mymetrics_isa_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+  void mymetrics_isa_deinit(UDF_INIT *initid);
+
 }
   
   mutex locale_mx;
 
-  my_bool init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+  my_bool init_locale(char *message) {
     lock_guard<mutex> guard(locale_mx);
     
     if (!strcmp("C", setlocale(LC_ALL, 0)) && !setlocale(LC_ALL, "en_US.UTF-8")) {
       strcpy(message, "Can't change default locale to UTF-8");
       return 1;
     }
-    
-    initid->maybe_null = 0;
-    if (args->arg_count != 2 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
-      strcpy(message, "This function requires two string arguments");
-      return 1;
+    return 0;
+  }
+
+  /*
+   * Optional last argument of the two-string metrics, a comma separated
+   * list. The character set of the strings, 'utf8' (the default) or a
+   * single-byte one, 'latin1' or 'ascii': MySQL 5 doesn't tell UDFs the
+   * charset of their arguments, so it is given here. Single-byte text, and
+   * UTF-8 rows that are all ASCII, go to the byte kernels straight from
+   * args->args. Then the normalisation done while decoding: 'lower',
+   * 'unaccent', 'translit', 'lookalike', 'spaces', 'nopunct', or 'fold' for
+   * all of them but translit.
+   */
+  enum charset { CS_UTF8, CS_LATIN1 };
+
+  struct string_options {
+    charset cs;
+    unsigned int norm;    /* NORM_* */
+
+    string_options() : cs(CS_UTF8), norm(0) {}
+  };
+
+  struct option_name {
+    const char *name;
+    unsigned int norm;
+  };
+
+  const option_name norm_options[] = {
+    { "lower", NORM_LOWER },
+    { "unaccent", NORM_UNACCENT },
+    { "translit", NORM_TRANSLIT },
+    { "lookalike", NORM_LOOKALIKE },
+    { "spaces", NORM_SPACES },
+    { "nopunct", NORM_NOPUNCT },
+    { "fold", NORM_LOWER | NORM_UNACCENT | NORM_LOOKALIKE | NORM_SPACES | NORM_NOPUNCT }
+  };
+
+  bool parse_options(const char *s, size_t l, string_options& o) {
+    for (size_t start = 0; start <= l;) {
+      const char *comma = (const char*)memchr(s + start, ',', l - start);
+      size_t end = comma ? comma - s : l;
+      string name;
+
+      for (size_t i = start; i < end; i++)
+        if (!isspace((unsigned char)s[i]))
+          name += tolower((unsigned char)s[i]);
+      if (name == "utf8" || name == "utf8mb3" || name == "utf8mb4")
+        o.cs = CS_UTF8;
+      else if (name == "latin1" || name == "ascii")
+        o.cs = CS_LATIN1;
+      else {
+        size_t k = 0, n = sizeof(norm_options) / sizeof(norm_options[0]);
+        while (k < n && name != norm_options[k].name)
+          k++;
+        if (k == n)
+          return false;
+        o.norm |= norm_options[k].norm;
+      }
+
+      if (!comma)
+        break;
+      start = comma - s + 1;
     }
+    return true;
+  }
 
-    if (!args->args[0] || !args->args[1]) {
-      strcpy(message, "This function requires non-NULL arguments");
+  /* options in argument i, which has to be a constant string */
+  my_bool init_options(UDF_ARGS *args, unsigned int i, string_options& o, char *message) {
+    if (args->arg_type[i] != STRING_RESULT || !args->args[i]) {
+      strcpy(message, "options must be a constant string");
       return 1;
     }
+    if (!parse_options(args->args[i], args->lengths[i], o)) {
+      strcpy(message, "options are utf8, latin1, ascii, lower, unaccent, translit, lookalike, spaces, nopunct, fold");
+      return 1;
+    }
+    return 0;
+  }
+
+  /*
+   * Value of constant argument i in _init, NaN if it is not a number.
+   * Constants come as they were written, the arg_type set in _init only
+   * converts row values: 2.0 and '2' are still strings here.
+   */
+  double constant_number(UDF_ARGS *args, unsigned int i) {
+    switch (args->arg_type[i]) {
+    case INT_RESULT:
+      return (double)*(longlong*)args->args[i];
+    case REAL_RESULT:
+      return *(double*)args->args[i];
+    default: {
+      string text(args->args[i], args->lengths[i]);
+      char *end;
+      double v = strtod(text.c_str(), &end);
+      while (end != text.c_str() && isspace((unsigned char)*end))
+        end++;
+      return end == text.c_str() || *end ? NAN : v;
+    }
+    }
+  }
+
+  /* whether constant argument i is a whole number from lo to hi */
+  bool constant_between(UDF_ARGS *args, unsigned int i, longlong lo, longlong hi) {
+    double v = constant_number(args, i);
+    return v == floor(v) && v >= lo && v <= hi;
+  }
+
+  /* per statement state of the two-string metrics, decoding buffers are reused from row to row */
+  struct metric_state {
+    string_options options;
+    wstring s1, s2;
+    vector<uint64_t> bi1, bi2;
+  };
+
+  my_bool init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    string_options options;
+
+    if (init_locale(message))
+      return 1;
     
+    /* args[i] is only set here for constant arguments, NULLs are seen row by row */
+    initid->maybe_null = 1;
+    if (args->arg_count < 2 || args->arg_count > 3 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "This function requires two string arguments and optional options");
+      return 1;
+    }
+    if (args->arg_count == 3 && init_options(args, 2, options, message))
+      return 1;
+
+    metric_state *st = new metric_state;
+    st->options = options;
+    initid->ptr = (char*)st;
     return 0;
   }
 
+  void deinit(UDF_INIT *initid) {
+    delete (metric_state*)initid->ptr;
+  }
+
+  /* a NULL among the first n arguments makes the result NULL */
+  bool null_args(UDF_ARGS *args, unsigned int n, char *is_null) {
+    for (unsigned int i = 0; i < n; i++)
+      if (!args->args[i]) {
+        *is_null = 1;
+        return true;
+      }
+    return false;
+  }
+
   wstring from_cstr(const char* s, size_t l) {
     wstring ws(l, L' ');
-    mbstowcs(&ws[0], s, l);
+    ws.resize(kernels().utf8_decode(s, l, &ws[0]));
     return ws;
   }
 
+  /* decodes into ws, keeping its capacity from row to row */
+  void from_cstr(const char* s, size_t l, wstring& ws) {
+    ws.resize(l);
+    ws.resize(kernels().utf8_decode(s, l, &ws[0]));
+  }
+
+  /* argument i decoded by the charset of the options */
+  void decode_arg(const string_options& o, UDF_ARGS *args, unsigned int i, wstring& ws) {
+    if (o.norm) {
+      bool utf8 = o.cs == CS_UTF8;
+      ws.resize(utf8 ? 2 * args->lengths[i] : args->lengths[i]);
+      if (utf8)
+        ws.resize(normalize_utf8(args->args[i], args->lengths[i], o.norm, &ws[0]));
+      else
+        ws.resize(normalize_latin1(args->args[i], args->lengths[i], o.norm, &ws[0]));
+      return;
+    }
+    if (o.cs == CS_UTF8) {
+      from_cstr(args->args[i], args->lengths[i], ws);
+      return;
+    }
+    const unsigned char *p = (const unsigned char*)args->args[i];
+    ws.resize(args->lengths[i]);
+    for (size_t k = 0; k < ws.size(); k++)
+      ws[k] = p[k] >= 0x80 && p[k] < 0xa0 ? cp1252_high[p[k] - 0x80] : p[k];
+  }
+
+  /*
+   * Whether the first two arguments can go to the byte kernels. A byte is a
+   * character in either case, so the metrics are unchanged; normalised
+   * strings are always decoded.
+   */
+  bool byte_args(const string_options& o, UDF_ARGS *args) {
+    if (o.norm)
+      return false;
+    return o.cs == CS_LATIN1 ||
+      (kernels().is_ascii(args->args[0], args->lengths[0]) && kernels().is_ascii(args->args[1], args->lengths[1]));
+  }
+
+  /*
+   * levenshtein(a, b [, max_dist] [, options]): with max_dist, anything
+   * farther gives max_dist + 1 and stops early. When a or b is constant the
+   * other one is a stream: the state of the previous row is reused up to
+   * the prefix they share, which pays off on sorted scans.
+   */
+  struct levenshtein_state {
+    string_options options;
+    bool bounded;                  /* max_dist is argument 2 */
+    levenshtein_stream *stream;
+    unsigned int candidate;        /* the non-constant argument of the stream */
+    wstring s1, s2;
+
+    levenshtein_state() : bounded(false), stream(0), candidate(1) {}
+    ~levenshtein_state() { delete stream; }
+  };
+
   longlong levenshtein(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
-    wstring s1 = from_cstr(args->args[0], args->lengths[0]);
-    wstring s2 = from_cstr(args->args[1], args->lengths[1]);
-    return levenshtein_dist(s1.c_str(), s2.c_str());
+    levenshtein_state *st = (levenshtein_state*)initid->ptr;
+    int max_dist = -1;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    /* NULL or negative max_dist: no bound */
+    if (st->bounded && args->args[2] && *(longlong*)args->args[2] >= 0)
+      max_dist = (int)min(*(longlong*)args->args[2], (longlong)INT_MAX - 1);
+
+    if (st->stream) {
+      /* an exception must not get out into the server */
+      try {
+        decode_arg(st->options, args, st->candidate, st->s2);
+        return st->stream->distance(st->s2.data(), st->s2.size(), max_dist);
+      } catch (const std::bad_alloc&) {
+        *error = 1;
+        return 0;
+      }
+    }
+
+    if (byte_args(st->options, args)) {
+      if (max_dist >= 0)
+        return kernels().levenshtein_bytes_bounded(args->args[0], args->lengths[0], args->args[1], args->lengths[1], max_dist);
+      return kernels().levenshtein_bytes(args->args[0], args->lengths[0], args->args[1], args->lengths[1]);
+    }
+
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    if (max_dist >= 0)
+      return kernels().levenshtein_bounded(st->s1.data(), st->s1.size(), st->s2.data(), st->s2.size(), max_dist);
+    return kernels().levenshtein(st->s1.data(), st->s1.size(), st->s2.data(), st->s2.size());
   }
 
   my_bool levenshtein_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
-    return init(initid, args, message);
+    string_options options;
+    unsigned int count = args->arg_count;
+
+    if (init_locale(message))
+      return 1;
+
+    /* a string after the two strings is the options, a number max_dist */
+    if (count > 2 && args->arg_type[count - 1] == STRING_RESULT) {
+      if (init_options(args, count - 1, options, message))
+        return 1;
+      count--;
+    }
+    if (count < 2 || count > 3 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "levenshtein(a, b [, max_dist] [, options]) requires two strings, an optional integer and optional options");
+      return 1;
+    }
+    if (count == 3)
+      args->arg_type[2] = INT_RESULT;
+
+    levenshtein_state *st = new levenshtein_state;
+    st->options = options;
+    st->bounded = count == 3;
+    for (unsigned int i = 0; i < 2; i++)
+      if (args->args[i]) {
+        decode_arg(options, args, i, st->s1);
+        st->stream = new levenshtein_stream(st->s1.data(), st->s1.size());
+        st->candidate = 1 - i;
+        break;
+      }
+
+    initid->maybe_null = 1;
+    initid->ptr = (char*)st;
+    return 0;
   }
 
-  void levenshtein_deinit(UDF_INIT *initid) {}
+  void levenshtein_deinit(UDF_INIT *initid) {
+    delete (levenshtein_state*)initid->ptr;
+  }
 
   longlong double_metaphone_eq(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
-    wstring s1 = from_cstr(args->args[0], args->lengths[0]);
-    wstring s2 = from_cstr(args->args[1], args->lengths[1]);
-    return dmetaphone_eq(s1.c_str(), s2.c_str());
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return dmetaphone_eq(st->s1, st->s2);
   }
 
   my_bool double_metaphone_eq_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     return init(initid, args, message);
   }
 
-  void double_metaphone_eq_deinit(UDF_INIT *initid) {}
+  void double_metaphone_eq_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
+
+  /*
+   * double_metaphone_primary(s), double_metaphone_secondary(s): the codes
+   * double_metaphone_eq compares, up to 32 symbols. double_metaphone_key(s
+   * [, secondary]) packs the first 12 symbols of the primary code (of the
+   * secondary one when the flag is set) into a BIGINT. Both are meant for
+   * indexed columns joined on equality.
+   */
+  struct metaphone_state {
+    wstring s, primary, secondary;
+  };
+
+  char *metaphone_code(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, bool secondary) {
+    metaphone_state *st = (metaphone_state*)initid->ptr;
+
+    if (null_args(args, 1, is_null))
+      return 0;
+    from_cstr(args->args[0], args->lengths[0], st->s);
+    dmetaphone_prefix(st->s, 32, st->primary, st->secondary);
+
+    const wstring& code = secondary ? st->secondary : st->primary;
+    /* the symbols are ASCII */
+    for (size_t i = 0; i < code.size(); i++)
+      result[i] = (char)code[i];
+    *length = code.size();
+    return result;
+  }
+
+  my_bool metaphone_init(UDF_INIT *initid, UDF_ARGS *args, char *message, unsigned int max_args, const char *usage) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count < 1 || args->arg_count > max_args || args->arg_type[0] != STRING_RESULT) {
+      strcpy(message, usage);
+      return 1;
+    }
+    for (unsigned int i = 1; i < args->arg_count; i++)
+      args->arg_type[i] = INT_RESULT;
+
+    initid->maybe_null = 1;
+    initid->max_length = 32;
+    initid->ptr = (char*)new metaphone_state;
+    return 0;
+  }
+
+  void metaphone_deinit(UDF_INIT *initid) {
+    delete (metaphone_state*)initid->ptr;
+  }
+
+  char *double_metaphone_primary(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    return metaphone_code(initid, args, result, length, is_null, false);
+  }
+
+  my_bool double_metaphone_primary_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return metaphone_init(initid, args, message, 1, "double_metaphone_primary(s) requires one string argument");
+  }
+
+  void double_metaphone_primary_deinit(UDF_INIT *initid) {
+    metaphone_deinit(initid);
+  }
+
+  char *double_metaphone_secondary(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    return metaphone_code(initid, args, result, length, is_null, true);
+  }
+
+  my_bool double_metaphone_secondary_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return metaphone_init(initid, args, message, 1, "double_metaphone_secondary(s) requires one string argument");
+  }
+
+  void double_metaphone_secondary_deinit(UDF_INIT *initid) {
+    metaphone_deinit(initid);
+  }
+
+  longlong double_metaphone_key(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    metaphone_state *st = (metaphone_state*)initid->ptr;
+
+    if (null_args(args, 1, is_null))
+      return 0;
+    bool secondary = args->arg_count > 1 && args->args[1] && *(longlong*)args->args[1];
+    from_cstr(args->args[0], args->lengths[0], st->s);
+    dmetaphone_prefix(st->s, dmetaphone_key_symbols, st->primary, st->secondary);
+    return ::dmetaphone_key(secondary ? st->secondary : st->primary);
+  }
+
+  my_bool double_metaphone_key_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return metaphone_init(initid, args, message, 2, "double_metaphone_key(s [, secondary]) requires a string and an optional integer");
+  }
+
+  void double_metaphone_key_deinit(UDF_INIT *initid) {
+    metaphone_deinit(initid);
+  }
+
+  /* ru_phonetic_key(s): Russian Metaphone key of s, for an indexed column joined on equality */
+  struct phonetic_state {
+    wstring s;
+    string key;
+  };
+
+  char *ru_phonetic_key(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    phonetic_state *st = (phonetic_state*)initid->ptr;
+
+    if (null_args(args, 1, is_null))
+      return 0;
+    from_cstr(args->args[0], args->lengths[0], st->s);
+    /* one byte per code point at most, result has room for 255 */
+    char *key = result;
+    if (st->s.size() > 255) {
+      st->key.resize(st->s.size());
+      key = &st->key[0];
+    }
+    *length = ::ru_phonetic_key(st->s.data(), st->s.size(), key);
+    return key;
+  }
+
+  my_bool ru_phonetic_key_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count != 1 || args->arg_type[0] != STRING_RESULT) {
+      strcpy(message, "ru_phonetic_key(s) requires one string argument");
+      return 1;
+    }
+
+    initid->maybe_null = 1;
+    initid->max_length = 1 << 24;
+    initid->ptr = (char*)new phonetic_state;
+    return 0;
+  }
+
+  void ru_phonetic_key_deinit(UDF_INIT *initid) {
+    delete (phonetic_state*)initid->ptr;
+  }
 
   double jaro_winkler(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
-    wstring s1 = from_cstr(args->args[0], args->lengths[0]);
-    wstring s2 = from_cstr(args->args[1], args->lengths[1]);
-    return jaro_winkler_dist(s1.c_str(), s2.c_str());
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    if (byte_args(st->options, args))
+      return jaro_winkler_bytes(args->args[0], args->lengths[0], args->args[1], args->lengths[1]);
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return jaro_winkler_dist(st->s1.data(), st->s1.size(), st->s2.data(), st->s2.size());
   }
 
   my_bool jaro_winkler_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     return init(initid, args, message);
   }
 
-  void jaro_winkler_deinit(UDF_INIT *initid) {}
+  void jaro_winkler_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
 
   double dice(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
-    wstring s1 = from_cstr(args->args[0], args->lengths[0]);
-    wstring s2 = from_cstr(args->args[1], args->lengths[1]);
-    return dice_coeff(s1.c_str(), s2.c_str());
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    if (byte_args(st->options, args))
+      return dice_coeff_bytes(args->args[0], args->lengths[0], args->args[1], args->lengths[1], st->bi1, st->bi2);
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return dice_coeff(st->s1.data(), st->s1.size(), st->s2.data(), st->s2.size(), st->bi1, st->bi2);
   }
 
   my_bool dice_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     return init(initid, args, message);
   }
 
-  void dice_deinit(UDF_INIT *initid) {}
+  void dice_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
+
+  /* dice_profile(s): bigrams of s stored once, compared by dice_profile_sim without decoding */
+  char *dice_profile(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    string *blob = (string*)initid->ptr;
+
+    if (null_args(args, 1, is_null))
+      return 0;
+
+    wstring s = from_cstr(args->args[0], args->lengths[0]);
+    dice_profile(s.data(), s.size(), *blob);
+    *length = blob->size();
+    return &(*blob)[0];
+  }
+
+  my_bool dice_profile_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count != 1 || args->arg_type[0] != STRING_RESULT) {
+      strcpy(message, "dice_profile(s) requires one string argument");
+      return 1;
+    }
+
+    initid->maybe_null = 1;
+    initid->max_length = 1 << 24;
+    initid->ptr = (char*)new string;
+    return 0;
+  }
+
+  void dice_profile_deinit(UDF_INIT *initid) {
+    delete (string*)initid->ptr;
+  }
+
+  double dice_profile_sim(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    if (null_args(args, 2, is_null))
+      return 0;
+
+    double d = dice_profile_coeff(args->args[0], args->lengths[0], args->args[1], args->lengths[1],
+                                  *(vector<uint64_t>*)initid->ptr);
+    if (d < 0) {
+      *error = 1;
+      return 0;
+    }
+    return d;
+  }
+
+  my_bool dice_profile_sim_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count != 2 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "dice_profile_sim(p1, p2) requires two dice_profile() blobs");
+      return 1;
+    }
+
+    initid->maybe_null = 1;
+    initid->ptr = (char*)new vector<uint64_t>;
+    return 0;
+  }
+
+  void dice_profile_sim_deinit(UDF_INIT *initid) {
+    delete (vector<uint64_t>*)initid->ptr;
+  }
+
+  double token_jaccard(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return token_jaccard_coeff(st->s1, st->s2);
+  }
+
+  my_bool token_jaccard_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return init(initid, args, message);
+  }
+
+  void token_jaccard_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
+
+  double token_sort_ratio(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return token_sort_coeff(st->s1, st->s2);
+  }
+
+  my_bool token_sort_ratio_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return init(initid, args, message);
+  }
+
+  void token_sort_ratio_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
+
+  double token_set_ratio(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    return token_set_coeff(st->s1, st->s2);
+  }
+
+  my_bool token_set_ratio_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return init(initid, args, message);
+  }
+
+  void token_set_ratio_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
 
+  /*
+   * fuzzy_contains(text, pattern, k [, options]) and fuzzy_position(text,
+   * pattern, k [, options]): whether, and where (1-based like locate(), 0
+   * if not, counted in the normalised text), text has a substring within k
+   * edits of pattern. A constant pattern is compiled once here, otherwise
+   * on every row.
+   */
+  struct fuzzy_state {
+    string_options options;
+    fuzzy_pattern pattern;
+    bool constant;
+    wstring text, buffer;
+  };
+
+  /* pattern of the row, NULL if an argument is */
+  fuzzy_state *fuzzy_row(UDF_INIT *initid, UDF_ARGS *args, char *is_null) {
+    fuzzy_state *st = (fuzzy_state*)initid->ptr;
+
+    if (null_args(args, 3, is_null))
+      return 0;
+    decode_arg(st->options, args, 0, st->text);
+    if (!st->constant) {
+      decode_arg(st->options, args, 1, st->buffer);
+      st->pattern.assign(st->buffer.data(), st->buffer.size());
+    }
+    return st;
+  }
+
+  /* k beyond any pattern length is as good as no limit */
+  int fuzzy_k(UDF_ARGS *args) {
+    return (int)max(min(*(longlong*)args->args[2], (longlong)INT_MAX), (longlong)-1);
+  }
+
+  my_bool fuzzy_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count < 3 || args->arg_count > 4 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "This function requires two strings, an integer and optional options");
+      return 1;
+    }
+    args->arg_type[2] = INT_RESULT;
+
+    string_options options;
+    if (args->arg_count == 4 && init_options(args, 3, options, message))
+      return 1;
+
+    fuzzy_state *st = new fuzzy_state;
+    st->options = options;
+    st->constant = args->args[1] != 0;
+    if (st->constant) {
+      decode_arg(options, args, 1, st->buffer);
+      st->pattern.assign(st->buffer.data(), st->buffer.size());
+    }
+    initid->maybe_null = 1;
+    initid->ptr = (char*)st;
+    return 0;
+  }
+
+  longlong fuzzy_contains(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    fuzzy_state *st = fuzzy_row(initid, args, is_null);
+    return st ? st->pattern.contains(st->text.data(), st->text.size(), fuzzy_k(args)) : 0;
+  }
+
+  my_bool fuzzy_contains_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return fuzzy_init(initid, args, message);
+  }
+
+  void fuzzy_contains_deinit(UDF_INIT *initid) {
+    delete (fuzzy_state*)initid->ptr;
+  }
+
+  longlong fuzzy_position(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    fuzzy_state *st = fuzzy_row(initid, args, is_null);
+    return st ? st->pattern.position(st->text.data(), st->text.size(), fuzzy_k(args)) : 0;
+  }
+
+  my_bool fuzzy_position_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return fuzzy_init(initid, args, message);
+  }
+
+  void fuzzy_position_deinit(UDF_INIT *initid) {
+    delete (fuzzy_state*)initid->ptr;
+  }
+
+  /*
+   * local_alignment_score(text, pattern [, match, mismatch, gap_open,
+   * gap_extend]): Smith-Waterman score of the best alignment of pattern
+   * with a region of text, by default +2 for a match, -1 for a mismatch
+   * and -3 - (n - 1) for a gap of n. The scores are constants, the profile
+   * of a constant pattern is built once here.
+   */
+  struct alignment_state {
+    alignment_scoring scoring;
+    local_alignment *constant;
+    wstring text, pattern;
+
+    alignment_state() : constant(0) {}
+    ~alignment_state() { delete constant; }
+  };
+
+  longlong local_alignment_score(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    alignment_state *st = (alignment_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    from_cstr(args->args[0], args->lengths[0], st->text);
+    if (st->constant)
+      return st->constant->score(st->text.data(), st->text.size());
+
+    from_cstr(args->args[1], args->lengths[1], st->pattern);
+    local_alignment row(st->pattern.data(), st->pattern.size(), st->scoring);
+    return row.score(st->text.data(), st->text.size());
+  }
+
+  my_bool local_alignment_score_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    alignment_scoring scoring = { 2, 1, 3, 1 };
+    int *values[] = { &scoring.match, &scoring.mismatch, &scoring.gap_open, &scoring.gap_extend };
+
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count < 2 || args->arg_count > 6 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "local_alignment_score(text, pattern [, match, mismatch, gap_open, gap_extend]) requires two strings and optional integers");
+      return 1;
+    }
+    for (unsigned int i = 2; i < args->arg_count; i++) {
+      if (!args->args[i]) {
+        strcpy(message, "the scores must be constants");
+        return 1;
+      }
+      double v = constant_number(args, i);
+      /* anything not a whole number in range fails the checks below */
+      *values[i - 2] = v == floor(v) ? (int)max(min(v, 1000.0), -1.0) : -1;
+      args->arg_type[i] = INT_RESULT;
+    }
+    if (scoring.match < 1 || scoring.match > 999 || scoring.mismatch < 0 || scoring.mismatch > 999 ||
+        scoring.gap_extend < 1 || scoring.gap_open < scoring.gap_extend || scoring.gap_open > 999) {
+      strcpy(message, "scores must be below 1000, match and gap_extend at least 1, gap_open at least gap_extend");
+      return 1;
+    }
+
+    alignment_state *st = new alignment_state;
+    st->scoring = scoring;
+    if (args->args[1]) {
+      from_cstr(args->args[1], args->lengths[1], st->pattern);
+      st->constant = new local_alignment(st->pattern.data(), st->pattern.size(), scoring);
+    }
+    initid->maybe_null = 1;
+    initid->ptr = (char*)st;
+    return 0;
+  }
+
+  void local_alignment_score_deinit(UDF_INIT *initid) {
+    delete (alignment_state*)initid->ptr;
+  }
+
+  /* hamming(a, b [, options]): characters that differ, NULL for strings of different lengths */
+  longlong hamming(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    metric_state *st = (metric_state*)initid->ptr;
+
+    if (null_args(args, 2, is_null))
+      return 0;
+    if (byte_args(st->options, args)) {
+      if (args->lengths[0] != args->lengths[1]) {
+        *is_null = 1;
+        return 0;
+      }
+      return kernels().hamming_bytes(args->args[0], args->args[1], args->lengths[0]);
+    }
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    if (st->s1.size() != st->s2.size()) {
+      *is_null = 1;
+      return 0;
+    }
+    return kernels().hamming(st->s1.data(), st->s2.data(), st->s1.size());
+  }
+
+  my_bool hamming_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return init(initid, args, message);
+  }
+
+  void hamming_deinit(UDF_INIT *initid) {
+    deinit(initid);
+  }
+
+  /* hamming_bits(b1, b2): bits that differ between two binary strings, NULL for different lengths */
+  longlong hamming_bits(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    if (null_args(args, 2, is_null))
+      return 0;
+    if (args->lengths[0] != args->lengths[1]) {
+      *is_null = 1;
+      return 0;
+    }
+    return kernels().hamming_bits(args->args[0], args->args[1], args->lengths[0]);
+  }
+
+  my_bool hamming_bits_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count != 2 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "hamming_bits(b1, b2) requires two binary strings");
+      return 1;
+    }
+    initid->maybe_null = 1;
+    return 0;
+  }
+
+  void hamming_bits_deinit(UDF_INIT *initid) {}
+
+  /* shingle size, integer argument checked here if constant and on every row otherwise */
+  const longlong max_qgram = 16;
+
+  my_bool init_shingles(UDF_INIT *initid, UDF_ARGS *args, char *message, unsigned int arg_count, const char *usage) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count != arg_count || args->arg_type[0] != STRING_RESULT) {
+      strcpy(message, usage);
+      return 1;
+    }
+    if (args->args[1] && !constant_between(args, 1, 1, max_qgram)) {
+      strcpy(message, "q must be between 1 and 16");
+      return 1;
+    }
+    for (unsigned int i = 1; i < arg_count; i++)
+      args->arg_type[i] = INT_RESULT;
+
+    initid->maybe_null = 1;
+    return 0;
+  }
+
+  char *minhash_sig(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    if (!args->args[0] || !args->args[1] || !args->args[2]) {
+      *is_null = 1;
+      return 0;
+    }
+
+    longlong q = *(longlong*)args->args[1];
+    longlong bands = *(longlong*)args->args[2];
+    if (q < 1 || q > max_qgram || bands < 1 || bands > minhash_max_bands) {
+      *error = 1;
+      return 0;
+    }
+
+    uint64_t keys[minhash_max_bands];
+    wstring s = from_cstr(args->args[0], args->lengths[0]);
+    minhash_bands(s, q, bands, keys);
+    memcpy(initid->ptr, keys, bands * sizeof(uint64_t));
+    *length = bands * sizeof(uint64_t);
+    return initid->ptr;
+  }
+
+  my_bool minhash_sig_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    /* before init_shingles asks for INT_RESULT, which only applies to rows */
+    if (args->arg_count == 3 && args->args[2] && !constant_between(args, 2, 1, minhash_max_bands)) {
+      strcpy(message, "bands must be between 1 and 32");
+      return 1;
+    }
+    if (init_shingles(initid, args, message, 3, "minhash_sig(s, q, bands) requires a string and two integers"))
+      return 1;
+
+    initid->max_length = minhash_max_bands * sizeof(uint64_t);
+    initid->ptr = new char[initid->max_length];
+    return 0;
+  }
+
+  void minhash_sig_deinit(UDF_INIT *initid) {
+    delete[] initid->ptr;
+  }
+
+  longlong simhash64(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    if (!args->args[0] || !args->args[1]) {
+      *is_null = 1;
+      return 0;
+    }
+
+    longlong q = *(longlong*)args->args[1];
+    if (q < 1 || q > max_qgram) {
+      *error = 1;
+      return 0;
+    }
+
+    wstring s = from_cstr(args->args[0], args->lengths[0]);
+    return (longlong)simhash(s, q);
+  }
+
+  my_bool simhash64_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    return init_shingles(initid, args, message, 2, "simhash64(s, q) requires a string and an integer");
+  }
+
+  void simhash64_deinit(UDF_INIT *initid) {}
+
+  /*
+   * string_similarity(a, b, 'lev,jw,dice,dm' [, options]): several metrics of one pair
+   * as a JSON object, {"lev":3,"jw":0.91,...} in the order asked. Both
+   * strings are decoded once, their common prefix and suffix are found once
+   * and equal strings skip the kernels.
+   */
+  enum similarity_metric { SIM_LEV, SIM_JW, SIM_DICE, SIM_DM };
+
+  const char *similarity_names[] = { "lev", "jw", "dice", "dm" };
+
+  struct similarity_state {
+    string_options options;
+    vector<similarity_metric> metrics;
+    bool constant_spec;
+    wstring s1, s2;
+    string result;
+  };
+
+  bool parse_similarity(const char *spec, size_t l, vector<similarity_metric>& metrics) {
+    metrics.clear();
+    for (size_t start = 0; start <= l;) {
+      const char *comma = (const char*)memchr(spec + start, ',', l - start);
+      size_t end = comma ? comma - spec : l, i;
+
+      while (start < end && isspace((unsigned char)spec[start]))
+        start++;
+      while (end > start && isspace((unsigned char)spec[end - 1]))
+        end--;
+      for (i = 0; i < sizeof(similarity_names) / sizeof(similarity_names[0]); i++)
+        if (strlen(similarity_names[i]) == end - start && !strncasecmp(spec + start, similarity_names[i], end - start))
+          break;
+      if (i == sizeof(similarity_names) / sizeof(similarity_names[0]))
+        return false;
+      /* each metric at most once, which also bounds the result for max_length */
+      if (find(metrics.begin(), metrics.end(), (similarity_metric)i) != metrics.end())
+        return false;
+      metrics.push_back((similarity_metric)i);
+
+      if (!comma)
+        break;
+      start = comma - spec + 1;
+    }
+    return true;
+  }
+
+  void append_similarity(const vector<similarity_metric>& metrics, const wstring& s1, const wstring& s2, string& out) {
+    size_t l1 = s1.size(), l2 = s2.size(), prefix = 0, suffix = 0;
+    char num[64];
+
+    /* common prefix and suffix once: levenshtein only sees the residue, jaro_winkler reuses the prefix */
+    while (prefix < l1 && prefix < l2 && s1[prefix] == s2[prefix])
+      prefix++;
+    while (suffix < l1 - prefix && suffix < l2 - prefix && s1[l1 - 1 - suffix] == s2[l2 - 1 - suffix])
+      suffix++;
+    bool same = l1 == l2 && prefix == l1;
+    size_t r1 = l1 - prefix - suffix, r2 = l2 - prefix - suffix;
+
+    out = "{";
+    for (size_t i = 0; i < metrics.size(); i++) {
+      double v;
+
+      switch (metrics[i]) {
+      case SIM_LEV:
+        /* a residue that is empty on one side leaves the length difference, the lower bound */
+        v = !r1 || !r2 ? r1 + r2 : kernels().levenshtein(s1.data() + prefix, r1, s2.data() + prefix, r2);
+        break;
+      case SIM_JW:
+        v = same && l1 ? 1.0 : jaro_winkler_dist(s1.data(), l1, s2.data(), l2, prefix);
+        break;
+      case SIM_DICE:
+        v = same && l1 > 1 ? 1.0 : dice_coeff(s1, s2);
+        break;
+      default:
+        v = same ? 1 : dmetaphone_eq(s1, s2);
+      }
+
+      if (i)
+        out += ',';
+      out += '"';
+      out += similarity_names[metrics[i]];
+      out += "\":";
+      /* dice of two one-letter strings is 0/0 */
+      if (std::isnan(v))
+        out += "null";
+      else
+        out.append(num, snprintf(num, sizeof(num), "%.15g", v));
+    }
+    out += '}';
+  }
+
+  char *string_similarity(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    similarity_state *st = (similarity_state*)initid->ptr;
+
+    if (!args->args[0] || !args->args[1] || !args->args[2]) {
+      *is_null = 1;
+      return 0;
+    }
+    if (!st->constant_spec && !parse_similarity(args->args[2], args->lengths[2], st->metrics)) {
+      *error = 1;
+      return 0;
+    }
+
+    decode_arg(st->options, args, 0, st->s1);
+    decode_arg(st->options, args, 1, st->s2);
+    append_similarity(st->metrics, st->s1, st->s2, st->result);
+    *length = st->result.size();
+    return &st->result[0];
+  }
+
+  my_bool string_similarity_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count < 3 || args->arg_count > 4 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+        args->arg_type[2] != STRING_RESULT) {
+      strcpy(message, "string_similarity(a, b, metrics [, options]) requires three string arguments and optional options");
+      return 1;
+    }
+
+    string_options options;
+    if (args->arg_count == 4 && init_options(args, 3, options, message))
+      return 1;
+
+    similarity_state *st = new similarity_state;
+    st->options = options;
+    st->constant_spec = args->args[2] != 0;
+    if (st->constant_spec && !parse_similarity(args->args[2], args->lengths[2], st->metrics)) {
+      delete st;
+      strcpy(message, "metrics must be a list of distinct lev, jw, dice, dm");
+      return 1;
+    }
+
+    initid->ptr = (char*)st;
+    initid->maybe_null = 1;
+    initid->max_length = 128;
+    return 0;
+  }
+
+  void string_similarity_deinit(UDF_INIT *initid) {
+    delete (similarity_state*)initid->ptr;
+  }
+
+  /*
+   * fuzzy_cluster(name, metric, threshold [, options]): aggregate over a
+   * group, a JSON object mapping every distinct name to the name that
+   * represents its cluster, {"Roga i kopyta":"Roga i kopyta OOO",...}. The
+   * names are decoded into the state as rows come and clustered once in
+   * the result, see leader_clustering. metric is 'jaro_winkler' (or 'jw')
+   * and 'dice', joined at a similarity of at least threshold, or
+   * 'levenshtein' ('lev'), joined within a distance of threshold.
+   */
+  struct cluster_state {
+    string_options options;
+    leader_clustering clusters;
+    string names;
+    vector<size_t> name_offsets;
+    vector<size_t> leader;
+    wstring buffer;
+    string result;
+
+    cluster_state(cluster_metric metric, double threshold) : clusters(metric, threshold), name_offsets(1, 0) {}
+  };
+
+  bool parse_cluster_metric(const char *s, size_t l, cluster_metric& metric) {
+    static const struct { const char *name; cluster_metric metric; } names[] = {
+      { "jaro_winkler", CLUSTER_JARO_WINKLER }, { "jw", CLUSTER_JARO_WINKLER },
+      { "levenshtein", CLUSTER_LEVENSHTEIN }, { "lev", CLUSTER_LEVENSHTEIN },
+      { "dice", CLUSTER_DICE },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+      if (strlen(names[i].name) == l && !strncasecmp(s, names[i].name, l)) {
+        metric = names[i].metric;
+        return true;
+      }
+    return false;
+  }
+
+  /* s as a JSON string */
+  void append_json_string(const char *s, size_t l, string& out) {
+    char esc[8];
+
+    out += '"';
+    for (size_t i = 0; i < l; i++) {
+      unsigned char c = s[i];
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (c < 0x20) {
+        out.append(esc, snprintf(esc, sizeof(esc), "\\u%04x", c));
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+
+  /* names[offsets[i], offsets[i + 1]) represented by name leader[i], each distinct name once in byte order */
+  void append_clusters(const string& names, const vector<size_t>& offsets, const vector<size_t>& leader, string& out) {
+    vector<size_t> order(leader.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return names.compare(offsets[a], offsets[a + 1] - offsets[a], names, offsets[b], offsets[b + 1] - offsets[b]) < 0;
+    });
+
+    out = "{";
+    for (size_t k = 0; k < order.size(); k++) {
+      size_t i = order[k], r = leader[i];
+      if (k && !names.compare(offsets[i], offsets[i + 1] - offsets[i], names, offsets[order[k - 1]], offsets[order[k - 1] + 1] - offsets[order[k - 1]]))
+        continue;
+      if (out.size() > 1)
+        out += ',';
+      append_json_string(names.data() + offsets[i], offsets[i + 1] - offsets[i], out);
+      out += ':';
+      append_json_string(names.data() + offsets[r], offsets[r + 1] - offsets[r], out);
+    }
+    out += '}';
+  }
+
+  char *fuzzy_cluster(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    cluster_state *st = (cluster_state*)initid->ptr;
+
+    if (!st->clusters.size()) {
+      *is_null = 1;
+      return 0;
+    }
+    st->clusters.run(st->leader);
+    append_clusters(st->names, st->name_offsets, st->leader, st->result);
+    *length = st->result.size();
+    return &st->result[0];
+  }
+
+  void fuzzy_cluster_clear(UDF_INIT *initid, char *is_null, char *error) {
+    cluster_state *st = (cluster_state*)initid->ptr;
+
+    st->clusters.clear();
+    st->names.clear();
+    st->name_offsets.assign(1, 0);
+  }
+
+  void fuzzy_cluster_add(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) {
+    cluster_state *st = (cluster_state*)initid->ptr;
+
+    if (!args->args[0])
+      return;
+    decode_arg(st->options, args, 0, st->buffer);
+    st->clusters.add(st->buffer.data(), st->buffer.size());
+    st->names.append(args->args[0], args->lengths[0]);
+    st->name_offsets.push_back(st->names.size());
+  }
+
+  my_bool fuzzy_cluster_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (init_locale(message))
+      return 1;
+
+    if (args->arg_count < 3 || args->arg_count > 4 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+      strcpy(message, "fuzzy_cluster(name, metric, threshold [, options]) requires two strings, a number and optional options");
+      return 1;
+    }
+
+    cluster_metric metric;
+    if (!args->args[1] || !parse_cluster_metric(args->args[1], args->lengths[1], metric)) {
+      strcpy(message, "metric must be a constant jaro_winkler, levenshtein or dice");
+      return 1;
+    }
+
+    double threshold = args->args[2] ? constant_number(args, 2) : -1;
+    if (!args->args[2] || !(threshold >= 0) || (metric != CLUSTER_LEVENSHTEIN && threshold > 1)) {
+      strcpy(message, "threshold must be a constant, from 0 to 1 for jaro_winkler and dice, a distance for levenshtein");
+      return 1;
+    }
+
+    string_options options;
+    if (args->arg_count == 4 && init_options(args, 3, options, message))
+      return 1;
+
+    cluster_state *st = new cluster_state(metric, threshold);
+    st->options = options;
+    initid->maybe_null = 1;
+    initid->max_length = 1 << 24;
+    initid->ptr = (char*)st;
+    return 0;
+  }
+
+  void fuzzy_cluster_deinit(UDF_INIT *initid) {
+    delete (cluster_state*)initid->ptr;
+  }
+
+  char *mymetrics_isa(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length, char *is_null, char *error) {
+    *length = strlen(kernels().name);
+    return (char*)kernels().name;
+  }
+
+  my_bool mymetrics_isa_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count) {
+      strcpy(message, "mymetrics_isa() takes no arguments");
+      return 1;
+    }
+    initid->maybe_null = 0;
+    initid->const_item = 1;
+    return 0;
+  }
+
+  void mymetrics_isa_deinit(UDF_INIT *initid) {}
+
+#ifdef MYMETRICS_SELFTEST
+/* the parts of the UDF layer that don't need a server, the metrics are tested in tests/selftest.cc */
 int main(int argc, const char* argv[]) {
-  assert(levenshtein_dist(L"ООО Рога и копыта", L"Рога и копыта, ООО") == 9);
+  vector<similarity_metric> metrics;
+  string json;
+  char num[128];
+  assert(parse_similarity("lev, JW,dice,dm", 15, metrics) && metrics.size() == 4);
+  assert(!parse_similarity("lev,soundex", 11, metrics));
+  assert(!parse_similarity("lev,jw,jw", 9, metrics));
+  /* the prefix and suffix found once give what the full strings do */
+  parse_similarity("lev,jw", 6, metrics);
+  append_similarity(metrics, L"abcdef", L"xbcdef", json);
+  snprintf(num, sizeof(num), "{\"lev\":1,\"jw\":%.15g}", jaro_winkler_dist(L"abcdef", L"xbcdef"));
+  assert(json == num);
+  append_similarity(metrics, L"abcdef", L"abcxyef", json);
+  snprintf(num, sizeof(num), "{\"lev\":2,\"jw\":%.15g}", jaro_winkler_dist(L"abcdef", L"abcxyef"));
+  assert(json == num);
+  append_similarity(metrics, L"abab", L"ab", json);
+  snprintf(num, sizeof(num), "{\"lev\":2,\"jw\":%.15g}", jaro_winkler_dist(L"abab", L"ab"));
+  assert(json == num);
+  /* the README example, printed with %.15g */
+  parse_similarity("lev,jw,dice,dm", 14, metrics);
+  append_similarity(metrics, L"peke", L"pique", json);
+  assert(json == "{\"lev\":3,\"jw\":0.67,\"dice\":0,\"dm\":1}");
+  parse_similarity("lev,dm,dice", 11, metrics);
+  append_similarity(metrics, L"peke", L"pique", json);
+  assert(json == "{\"lev\":3,\"dm\":1,\"dice\":0}");
+  append_similarity(metrics, L"a", L"a", json);
+  assert(json == "{\"lev\":0,\"dm\":1,\"dice\":null}");
 
-  assert(dmetaphone_eq(L"mère", L"mer"));
-  assert(dmetaphone_eq(L"peke", L"pique"));
-  assert(!dmetaphone_eq(L"bloat", L"float"));
+  string_options options;
+  assert(parse_options("ascii", 5, options) && options.cs == CS_LATIN1);
+  assert(parse_options("UTF8MB4", 7, options) && options.cs == CS_UTF8);
+  assert(!parse_options("koi8r", 5, options));
+  /* constants as MySQL passes them to _init, in the type they were written in; init_locale wants a UTF-8 locale already set */
+  if (!setlocale(LC_ALL, "C.UTF-8"))
+    setlocale(LC_ALL, "en_US.UTF-8");
+  {
+    longlong gap_open = 3;
+    double gap_extend = 1.0;
+    Item_result types[] = { STRING_RESULT, STRING_RESULT, DECIMAL_RESULT, STRING_RESULT, INT_RESULT, REAL_RESULT };
+    char *values[] = { 0, (char*)"ab", (char*)"2.0", (char*)"1", (char*)&gap_open, (char*)&gap_extend };
+    unsigned long lengths[] = { 0, 2, 3, 1, 8, 8 };
+    UDF_ARGS args;
+    UDF_INIT initid;
+    char message[256], is_null = 0, error = 0;
+    memset(&args, 0, sizeof(args));
+    args.arg_count = 6;
+    args.arg_type = types;
+    args.args = values;
+    args.lengths = lengths;
+    assert(!local_alignment_score_init(&initid, &args, message));
+    values[0] = (char*)"xxabxx";
+    lengths[0] = 6;
+    assert(local_alignment_score(&initid, &args, &is_null, &error) == 4 && !is_null);
+    local_alignment_score_deinit(&initid);
 
-  assert(floor(100 * jaro_winkler_dist(L"ООО Рага и копыта", L"Рога и копыта, ООО")) == 70.0);
+    types[2] = DECIMAL_RESULT;
+    values[2] = (char*)"2.5";
+    assert(local_alignment_score_init(&initid, &args, message));
+    types[2] = STRING_RESULT;
+    values[2] = (char*)"two";
+    assert(local_alignment_score_init(&initid, &args, message));
+  }
+
+  {
+    Item_result types[] = { STRING_RESULT, STRING_RESULT, DECIMAL_RESULT };
+    char *values[] = { 0, (char*)"2", (char*)"8.0" };
+    unsigned long lengths[] = { 0, 1, 3 };
+    UDF_ARGS args;
+    UDF_INIT initid;
+    char message[256];
+    memset(&args, 0, sizeof(args));
+    args.arg_count = 3;
+    args.arg_type = types;
+    args.args = values;
+    args.lengths = lengths;
+    assert(!minhash_sig_init(&initid, &args, message) && types[1] == INT_RESULT && types[2] == INT_RESULT);
+    minhash_sig_deinit(&initid);
+    types[1] = STRING_RESULT;
+    types[2] = DECIMAL_RESULT;
+    values[2] = (char*)"33";
+    lengths[2] = 2;
+    assert(minhash_sig_init(&initid, &args, message) && !strcmp(message, "bands must be between 1 and 32"));
+    args.arg_count = 2;
+    values[1] = (char*)"17";
+    lengths[1] = 2;
+    assert(simhash64_init(&initid, &args, message) && !strcmp(message, "q must be between 1 and 16"));
+    values[1] = (char*)"3";
+    lengths[1] = 1;
+    assert(!simhash64_init(&initid, &args, message));
+  }
 
-  assert(floor(100 * dice_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО")) == 70.0);
+  cluster_metric metric;
+  assert(parse_cluster_metric("JW", 2, metric) && metric == CLUSTER_JARO_WINKLER && !parse_cluster_metric("soundex", 7, metric));
+  /* "Roga\"", "Roga i kopyta", "Roga", "Roga" */
+  string names = "Roga\"Roga i kopytaRogaRoga";
+  vector<size_t> offsets, leader;
+  offsets.push_back(0), offsets.push_back(5), offsets.push_back(18), offsets.push_back(22), offsets.push_back(26);
+  leader.push_back(0), leader.push_back(0), leader.push_back(2), leader.push_back(2);
+  append_clusters(names, offsets, leader, json);
+  assert(json == "{\"Roga\":\"Roga\",\"Roga i kopyta\":\"Roga\\\"\",\"Roga\\\"\":\"Roga\\\"\"}");
+
+  assert(parse_options("latin1, fold", 12, options) && options.cs == CS_LATIN1 && (options.norm & NORM_NOPUNCT) && !(options.norm & NORM_TRANSLIT));
   return 0;
 }
-
+#endif
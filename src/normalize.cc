@@ -0,0 +1,223 @@
+/*
+ * Normalisation fused into decoding: UTF-8 is decoded a block at a time by
+ * the kernels into a buffer that stays in L1, and every code point of the
+ * block goes through the steps straight into the output. The tables are
+ * generated from the Unicode data: the base letter of every precomposed
+ * letter (0 when there is none).
+ */
+
+#include "normalize.h"
+#include "dispatch.h"
+#include <algorithm>
+#include <cctype>
+#include <cwctype>
+#include <stdint.h>
+
+using namespace std;
+
+const wchar_t cp1252_high[32] = {
+    0x20ac, 0x81, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x8d, 0x017d, 0x8f,
+    0x90, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x9d, 0x017e, 0x0178
+};
+
+static const uint16_t latin_base[0x190] = {
+    0x0041, 0x0041, 0x0041, 0x0041, 0x0041, 0x0041, 0x0000, 0x0043, 0x0045, 0x0045, 0x0045, 0x0045,
+    0x0049, 0x0049, 0x0049, 0x0049, 0x0000, 0x004e, 0x004f, 0x004f, 0x004f, 0x004f, 0x004f, 0x0000,
+    0x0000, 0x0055, 0x0055, 0x0055, 0x0055, 0x0059, 0x0000, 0x0000, 0x0061, 0x0061, 0x0061, 0x0061,
+    0x0061, 0x0061, 0x0000, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x0000, 0x006e, 0x006f, 0x006f, 0x006f, 0x006f, 0x006f, 0x0000, 0x0000, 0x0075, 0x0075, 0x0075,
+    0x0075, 0x0079, 0x0000, 0x0079, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061, 0x0043, 0x0063,
+    0x0043, 0x0063, 0x0043, 0x0063, 0x0043, 0x0063, 0x0044, 0x0064, 0x0000, 0x0000, 0x0045, 0x0065,
+    0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0047, 0x0067, 0x0047, 0x0067,
+    0x0047, 0x0067, 0x0047, 0x0067, 0x0048, 0x0068, 0x0000, 0x0000, 0x0049, 0x0069, 0x0049, 0x0069,
+    0x0049, 0x0069, 0x0049, 0x0069, 0x0049, 0x0000, 0x0000, 0x0000, 0x004a, 0x006a, 0x004b, 0x006b,
+    0x0000, 0x004c, 0x006c, 0x004c, 0x006c, 0x004c, 0x006c, 0x0000, 0x0000, 0x0000, 0x0000, 0x004e,
+    0x006e, 0x004e, 0x006e, 0x004e, 0x006e, 0x0000, 0x0000, 0x0000, 0x004f, 0x006f, 0x004f, 0x006f,
+    0x004f, 0x006f, 0x0000, 0x0000, 0x0052, 0x0072, 0x0052, 0x0072, 0x0052, 0x0072, 0x0053, 0x0073,
+    0x0053, 0x0073, 0x0053, 0x0073, 0x0053, 0x0073, 0x0054, 0x0074, 0x0054, 0x0074, 0x0000, 0x0000,
+    0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075,
+    0x0057, 0x0077, 0x0059, 0x0079, 0x0059, 0x005a, 0x007a, 0x005a, 0x007a, 0x005a, 0x007a, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x004f, 0x006f, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0055,
+    0x0075, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0041, 0x0061, 0x0049, 0x0069, 0x004f, 0x006f, 0x0055,
+    0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0000, 0x0041, 0x0061,
+    0x0041, 0x0061, 0x00c6, 0x00e6, 0x0000, 0x0000, 0x0047, 0x0067, 0x004b, 0x006b, 0x004f, 0x006f,
+    0x004f, 0x006f, 0x01b7, 0x0292, 0x006a, 0x0000, 0x0000, 0x0000, 0x0047, 0x0067, 0x0000, 0x0000,
+    0x004e, 0x006e, 0x0041, 0x0061, 0x00c6, 0x00e6, 0x00d8, 0x00f8, 0x0041, 0x0061, 0x0041, 0x0061,
+    0x0045, 0x0065, 0x0045, 0x0065, 0x0049, 0x0069, 0x0049, 0x0069, 0x004f, 0x006f, 0x004f, 0x006f,
+    0x0052, 0x0072, 0x0052, 0x0072, 0x0055, 0x0075, 0x0055, 0x0075, 0x0053, 0x0073, 0x0054, 0x0074,
+    0x0000, 0x0000, 0x0048, 0x0068, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0041, 0x0061,
+    0x0045, 0x0065, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x0059, 0x0079,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000
+};
+
+static const uint16_t greek_base[0x4a] = {
+    0x0391, 0x0000, 0x0395, 0x0397, 0x0399, 0x0000, 0x039f, 0x0000, 0x03a5, 0x03a9, 0x03b9, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0399, 0x03a5, 0x03b1, 0x03b5, 0x03b7, 0x03b9, 0x03c5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x03b9, 0x03c5, 0x03bf, 0x03c5,
+    0x03c9, 0x0000
+};
+
+static const uint16_t cyrillic_base[0x60] = {
+    0x0415, 0x0415, 0x0000, 0x0413, 0x0000, 0x0000, 0x0000, 0x0406, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x041a, 0x0418, 0x0423, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0418, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0438, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0435, 0x0435, 0x0000, 0x0433,
+    0x0000, 0x0000, 0x0000, 0x0456, 0x0000, 0x0000, 0x0000, 0x0000, 0x043a, 0x0438, 0x0443, 0x0000
+};
+
+static const uint16_t latin_additional_base[0x100] = {
+    0x0041, 0x0061, 0x0042, 0x0062, 0x0042, 0x0062, 0x0042, 0x0062, 0x0043, 0x0063, 0x0044, 0x0064,
+    0x0044, 0x0064, 0x0044, 0x0064, 0x0044, 0x0064, 0x0044, 0x0064, 0x0045, 0x0065, 0x0045, 0x0065,
+    0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0046, 0x0066, 0x0047, 0x0067, 0x0048, 0x0068,
+    0x0048, 0x0068, 0x0048, 0x0068, 0x0048, 0x0068, 0x0048, 0x0068, 0x0049, 0x0069, 0x0049, 0x0069,
+    0x004b, 0x006b, 0x004b, 0x006b, 0x004b, 0x006b, 0x004c, 0x006c, 0x004c, 0x006c, 0x004c, 0x006c,
+    0x004c, 0x006c, 0x004d, 0x006d, 0x004d, 0x006d, 0x004d, 0x006d, 0x004e, 0x006e, 0x004e, 0x006e,
+    0x004e, 0x006e, 0x004e, 0x006e, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f,
+    0x0050, 0x0070, 0x0050, 0x0070, 0x0052, 0x0072, 0x0052, 0x0072, 0x0052, 0x0072, 0x0052, 0x0072,
+    0x0053, 0x0073, 0x0053, 0x0073, 0x0053, 0x0073, 0x0053, 0x0073, 0x0053, 0x0073, 0x0054, 0x0074,
+    0x0054, 0x0074, 0x0054, 0x0074, 0x0054, 0x0074, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075,
+    0x0055, 0x0075, 0x0055, 0x0075, 0x0056, 0x0076, 0x0056, 0x0076, 0x0057, 0x0077, 0x0057, 0x0077,
+    0x0057, 0x0077, 0x0057, 0x0077, 0x0057, 0x0077, 0x0058, 0x0078, 0x0058, 0x0078, 0x0059, 0x0079,
+    0x005a, 0x007a, 0x005a, 0x007a, 0x005a, 0x007a, 0x0068, 0x0074, 0x0077, 0x0079, 0x0000, 0x017f,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061,
+    0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061, 0x0041, 0x0061,
+    0x0041, 0x0061, 0x0041, 0x0061, 0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065,
+    0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0045, 0x0065, 0x0049, 0x0069, 0x0049, 0x0069,
+    0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f,
+    0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f, 0x004f, 0x006f,
+    0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075, 0x0055, 0x0075,
+    0x0055, 0x0075, 0x0059, 0x0079, 0x0059, 0x0079, 0x0059, 0x0079, 0x0059, 0x0079, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000
+};
+
+struct base_range {
+    wchar_t lo, hi;
+    const uint16_t* base;
+};
+
+static const base_range base_ranges[] = {
+    { 0x00c0, 0x0250, latin_base },
+    { 0x0386, 0x03d0, greek_base },
+    { 0x0400, 0x0460, cyrillic_base },
+    { 0x1e00, 0x1f00, latin_additional_base }
+};
+
+/* а..я, ICAO 9303 */
+static const char* const cyrillic_latin[32] = {
+    "a", "b", "v", "g", "d", "e", "zh", "z", "i", "i", "k", "l", "m", "n", "o", "p",
+    "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "ie", "y", "", "e", "iu", "ia"
+};
+
+/* letters of other scripts drawn like Latin ones, by code point */
+static const wchar_t lookalikes[][2] = {
+    { 0x0391, 'A' }, { 0x0392, 'B' }, { 0x0395, 'E' }, { 0x0396, 'Z' }, { 0x0397, 'H' }, { 0x0399, 'I' },
+    { 0x039a, 'K' }, { 0x039c, 'M' }, { 0x039d, 'N' }, { 0x039f, 'O' }, { 0x03a1, 'P' }, { 0x03a4, 'T' },
+    { 0x03a5, 'Y' }, { 0x03a7, 'X' }, { 0x03bf, 'o' },
+    { 0x0405, 'S' }, { 0x0406, 'I' }, { 0x0408, 'J' }, { 0x0410, 'A' }, { 0x0412, 'B' }, { 0x0415, 'E' },
+    { 0x041a, 'K' }, { 0x041c, 'M' }, { 0x041d, 'H' }, { 0x041e, 'O' }, { 0x0420, 'P' }, { 0x0421, 'C' },
+    { 0x0422, 'T' }, { 0x0423, 'Y' }, { 0x0425, 'X' }, { 0x0430, 'a' }, { 0x0435, 'e' }, { 0x043e, 'o' },
+    { 0x0440, 'p' }, { 0x0441, 'c' }, { 0x0443, 'y' }, { 0x0445, 'x' }, { 0x0455, 's' }, { 0x0456, 'i' },
+    { 0x0458, 'j' }, { 0x04bb, 'h' }, { 0x051a, 'Q' }, { 0x051b, 'q' }, { 0x051c, 'W' }, { 0x051d, 'w' }
+};
+
+static bool lookalike_less(const wchar_t* a, wchar_t c) {
+    return a[0] < c;
+}
+
+/* carried from block to block */
+struct norm_state {
+    unsigned int flags;
+    bool emitted;    /* something was written, a space may follow */
+    bool space;      /* a space is due before the next character */
+};
+
+static inline wchar_t *emit(norm_state& st, wchar_t c, wchar_t* out) {
+    if (st.space) {
+        *out++ = ' ';
+        st.space = false;
+    }
+    *out++ = st.flags & NORM_LOWER ? towlower(c) : c;
+    st.emitted = true;
+    return out;
+}
+
+static wchar_t *normalize_one(norm_state& st, wchar_t c, wchar_t* out) {
+    unsigned int flags = st.flags;
+
+    if (flags & NORM_UNACCENT) {
+        if (c >= 0x300 && c < 0x370)
+            return out;
+        for (size_t r = 0; r < sizeof(base_ranges) / sizeof(base_ranges[0]); r++)
+            if (c >= base_ranges[r].lo && c < base_ranges[r].hi) {
+                if (base_ranges[r].base[c - base_ranges[r].lo])
+                    c = base_ranges[r].base[c - base_ranges[r].lo];
+                break;
+            }
+    }
+    if (c < 0x80 ? ispunct(c) : iswpunct(c)) {
+        if (flags & NORM_NOPUNCT)
+            return out;
+    } else if (c < 0x80 ? isspace(c) : iswspace(c)) {
+        if (flags & NORM_SPACES) {
+            st.space = st.emitted;
+            return out;
+        }
+    }
+
+    if ((flags & NORM_TRANSLIT) && ((c >= 0x410 && c < 0x450) || c == 0x401 || c == 0x451)) {
+        bool upper = c < 0x430 || c == 0x401;
+        const char* latin = cyrillic_latin[c == 0x401 || c == 0x451 ? 5 : (c - 0x410) & 31];
+        for (const char* p = latin; *p; p++)
+            out = emit(st, upper && p == latin ? toupper(*p) : *p, out);
+        return out;
+    }
+    if ((flags & NORM_LOOKALIKE) && c >= 0x391 && c <= 0x51d) {
+        const wchar_t (*end)[2] = lookalikes + sizeof(lookalikes) / sizeof(lookalikes[0]);
+        const wchar_t (*at)[2] = lower_bound(lookalikes, end, c, lookalike_less);
+        if (at != end && (*at)[0] == c)
+            c = (*at)[1];
+    }
+    return emit(st, c, out);
+}
+
+size_t normalize_utf8(const char* s, size_t l, unsigned int flags, wchar_t* out) {
+    const size_t block = 256;
+    wchar_t decoded[block];
+    norm_state st = { flags, false, false };
+    wchar_t* o = out;
+
+    for (size_t i = 0; i < l;) {
+        size_t end = min(l, i + block);
+        /* cut before a character, not inside one */
+        for (size_t k = 0; k < 3 && end < l && end > i + 1 && (s[end] & 0xc0) == 0x80; k++)
+            end--;
+        size_t n = kernels().utf8_decode(s + i, end - i, decoded);
+        for (size_t k = 0; k < n; k++)
+            o = normalize_one(st, decoded[k], o);
+        i = end;
+    }
+    return o - out;
+}
+
+size_t normalize_latin1(const char* s, size_t l, unsigned int flags, wchar_t* out) {
+    const unsigned char* p = (const unsigned char*)s;
+    norm_state st = { flags, false, false };
+    wchar_t* o = out;
+
+    for (size_t i = 0; i < l; i++)
+        o = normalize_one(st, p[i] >= 0x80 && p[i] < 0xa0 ? cp1252_high[p[i] - 0x80] : p[i], o);
+    return o - out;
+}
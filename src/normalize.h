@@ -0,0 +1,23 @@
+#include <cstddef>
+
+/*
+ * Normalisation applied while decoding, so that a normalised comparison
+ * still reads every string once. Steps are flags and combine freely:
+ */
+enum {
+    NORM_LOWER = 1,       /* lower case */
+    NORM_UNACCENT = 2,    /* letters to the base letter of their NFD, combining marks dropped */
+    NORM_TRANSLIT = 4,    /* Cyrillic to Latin as in passports (ICAO 9303): щ -> shch */
+    NORM_LOOKALIKE = 8,   /* Cyrillic and Greek letters that look Latin to the Latin letter: О -> O */
+    NORM_SPACES = 16,     /* runs of whitespace to one space, none at the ends */
+    NORM_NOPUNCT = 32     /* punctuation dropped */
+};
+
+/* what MySQL's latin1 (cp1252) has at 0x80..0x9f, unassigned bytes stay as they are */
+extern const wchar_t cp1252_high[32];
+
+/* UTF-8 to normalised code points, out needs room for 2 * l */
+size_t normalize_utf8(const char* s, size_t l, unsigned int flags, wchar_t* out);
+
+/* latin1 (cp1252) to normalised code points, out needs room for l */
+size_t normalize_latin1(const char* s, size_t l, unsigned int flags, wchar_t* out);
@@ -0,0 +1,145 @@
+#include "pack.h"
+#include "dice.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char pack_magic[8] = "MMPACK1";
+
+static uint64_t section_end(uint64_t at, uint64_t bytes) {
+    return (at + bytes + 63) & ~(uint64_t)63;
+}
+
+void pack_builder::add(const wchar_t* s, size_t l) {
+    for (size_t i = 0; i < l; i++) {
+        arena.push_back(s[i]);
+        if ((uint32_t)s[i] > widest)
+            widest = s[i];
+    }
+    arena.push_back(0);
+    offsets.push_back(arena.size());
+    lengths.push_back(l);
+
+    if (bigrams) {
+        dice_bigrams(s, l, scratch);
+        bigram_words.insert(bigram_words.end(), scratch.begin(), scratch.end());
+        bigram_offsets.push_back(bigram_words.size());
+    }
+}
+
+static bool write_section(FILE* f, const void* data, size_t bytes, uint64_t end) {
+    static const char zeros[64] = {0};
+    long at = ftell(f);
+    return fwrite(data, 1, bytes, f) == bytes && fwrite(zeros, 1, end - at - bytes, f) == end - at - bytes;
+}
+
+bool pack_builder::write(const char* path) const {
+    pack_header h;
+    size_t count = lengths.size();
+    bool narrow = widest < 256;
+    std::vector<unsigned char> bytes;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, pack_magic, sizeof(h.magic));
+    h.byte_order = pack_byte_order;
+    h.flags = (narrow ? PACK_NARROW : 0) | (bigrams ? PACK_BIGRAMS : 0);
+    h.count = count;
+    h.arena_size = arena.size();
+    h.bigram_words = bigram_words.size();
+    h.offsets_at = section_end(0, sizeof(h));
+    h.lengths_at = section_end(h.offsets_at, (count + 1) * 8);
+    h.arena_at = section_end(h.lengths_at, count * 4);
+    h.bigrams_at = section_end(h.arena_at, arena.size() * (narrow ? 1 : 4));
+    h.size = bigrams ? section_end(h.bigrams_at, (count + 1 + bigram_words.size()) * 8) : h.bigrams_at;
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = write_section(f, &h, sizeof(h), h.offsets_at) &&
+        write_section(f, &offsets[0], (count + 1) * 8, h.lengths_at) &&
+        write_section(f, lengths.data(), count * 4, h.arena_at);
+    if (ok && narrow) {
+        bytes.assign(arena.begin(), arena.end());
+        ok = write_section(f, bytes.data(), bytes.size(), h.bigrams_at);
+    } else if (ok) {
+        ok = write_section(f, arena.data(), arena.size() * 4, h.bigrams_at);
+    }
+    if (ok && bigrams)
+        ok = fwrite(&bigram_offsets[0], 8, count + 1, f) == count + 1 &&
+            write_section(f, bigram_words.data(), bigram_words.size() * 8, h.size);
+    if (fclose(f))
+        ok = false;
+    return ok;
+}
+
+bool corpus_pack::is_pack(const char* path) {
+    char magic[8];
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool is = fread(magic, 1, 8, f) == 8 && !memcmp(magic, pack_magic, 8);
+    fclose(f);
+    return is;
+}
+
+bool corpus_pack::open(const char* path, std::string& error) {
+    struct stat st;
+    int fd;
+
+    close();
+    if ((fd = ::open(path, O_RDONLY)) < 0 || fstat(fd, &st)) {
+        error = strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    if ((size_t)st.st_size < sizeof(pack_header)) {
+        ::close(fd);
+        error = "not a corpus pack";
+        return false;
+    }
+    void* m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+    map = (const char*)m;
+    mapped = st.st_size;
+
+    const pack_header* h = (const pack_header*)map;
+    bool narrow = h->flags & PACK_NARROW;
+    if (memcmp(h->magic, pack_magic, 8))
+        error = "not a corpus pack";
+    else if (h->byte_order != pack_byte_order)
+        error = "corpus pack of another byte order";
+    else if (!narrow && sizeof(wchar_t) != 4)
+        error = "wide corpus pack needs a 4-byte wchar_t";
+    else if (h->size > mapped || h->count >= h->size || h->arena_size >= h->size || h->bigram_words >= h->size ||
+             h->offsets_at + (h->count + 1) * 8 > h->lengths_at || h->lengths_at + h->count * 4 > h->arena_at ||
+             h->arena_at + h->arena_size * (narrow ? 1 : 4) > h->bigrams_at ||
+             h->bigrams_at + ((h->flags & PACK_BIGRAMS) ? (h->count + 1 + h->bigram_words) * 8 : 0) > h->size ||
+             (h->offsets_at | h->lengths_at | h->arena_at | h->bigrams_at) % 64)
+        error = "truncated or damaged corpus pack";
+    else if (((const uint64_t*)(map + h->offsets_at))[h->count] != h->arena_size ||
+             ((h->flags & PACK_BIGRAMS) && ((const uint64_t*)(map + h->bigrams_at))[h->count] != h->bigram_words))
+        error = "truncated or damaged corpus pack";
+    else {
+        header = h;
+        return true;
+    }
+    close();
+    return false;
+}
+
+void corpus_pack::close() {
+    if (map)
+        munmap((void*)map, mapped);
+    map = 0;
+    mapped = 0;
+    header = 0;
+}
@@ -0,0 +1,92 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Corpus pack: a list of strings decoded once and stored the way the
+ * kernels read them, so batch jobs map it and start without parsing or
+ * decoding. Layout, every section at a multiple of 64 bytes, integers in
+ * the byte order of the machine that wrote it:
+ *
+ *   header     pack_header below
+ *   offsets    uint64 x (count + 1), start of every string in the arena
+ *   lengths    uint32 x count, code points of every string
+ *   arena      the strings, each followed by a 0: one byte per code point
+ *              when all are below 256 (narrow), else UTF-32
+ *   bigrams    optional, uint64 x (count + 1) starts in the words that
+ *              follow, the sorted dice_bigrams of every string
+ */
+struct pack_header {
+    char magic[8];              /* "MMPACK1" */
+    uint32_t byte_order;        /* pack_byte_order as written */
+    uint32_t flags;
+    uint64_t count;
+    uint64_t arena_size;        /* code points with the terminators */
+    uint64_t bigram_words;
+    uint64_t offsets_at, lengths_at, arena_at, bigrams_at, size;
+};
+
+const uint32_t pack_byte_order = 0x01020304;
+const uint32_t PACK_NARROW = 1;
+const uint32_t PACK_BIGRAMS = 2;
+
+/* collects strings in memory and writes the pack */
+class pack_builder {
+  public:
+    explicit pack_builder(bool bigrams) : bigrams(bigrams), widest(0) { offsets.push_back(0); bigram_offsets.push_back(0); }
+
+    void add(const wchar_t* s, size_t l);
+    size_t size() const { return lengths.size(); }
+
+    /* false with errno set when the file can't be written */
+    bool write(const char* path) const;
+
+  private:
+    bool bigrams;
+    uint32_t widest;
+    std::vector<uint32_t> arena, lengths;
+    std::vector<uint64_t> offsets, bigram_offsets, bigram_words, scratch;
+};
+
+/*
+ * A pack mapped read-only, strings are read in place. A narrow pack is
+ * read with bytes(), a wide one with str(). The sections are checked to be
+ * inside the file, not every offset: the pack is trusted as written.
+ */
+class corpus_pack {
+  public:
+    corpus_pack() : map(0), mapped(0), header(0) {}
+    ~corpus_pack() { close(); }
+
+    /* false with a message in error when path is not a pack this build can read */
+    bool open(const char* path, std::string& error);
+    void close();
+    bool is_open() const { return header != 0; }
+
+    size_t size() const { return header->count; }
+    bool narrow() const { return header->flags & PACK_NARROW; }
+    bool has_bigrams() const { return header->flags & PACK_BIGRAMS; }
+    size_t arena_size() const { return header->arena_size; }
+
+    const uint64_t* offsets() const { return (const uint64_t*)(map + header->offsets_at); }
+    size_t length(size_t i) const { return ((const uint32_t*)(map + header->lengths_at))[i]; }
+    const wchar_t* str(size_t i) const { return (const wchar_t*)(map + header->arena_at) + offsets()[i]; }
+    const char* bytes(size_t i) const { return map + header->arena_at + offsets()[i]; }
+
+    size_t bigram_count(size_t i) const { return bigram_offsets()[i + 1] - bigram_offsets()[i]; }
+    const uint64_t* bigrams(size_t i) const { return bigram_offsets() + header->count + 1 + bigram_offsets()[i]; }
+
+    /* true if the file starts like a pack, whatever else is in it */
+    static bool is_pack(const char* path);
+
+  private:
+    corpus_pack(const corpus_pack&);
+    corpus_pack& operator=(const corpus_pack&);
+
+    const uint64_t* bigram_offsets() const { return (const uint64_t*)(map + header->bigrams_at); }
+
+    const char* map;
+    size_t mapped;
+    const pack_header* header;
+};
@@ -0,0 +1,96 @@
+#include "ruphonetic.h"
+
+/* symbol of every letter а..я, 0 for the signs */
+static const char cyrillic[32] = {
+    'A', 'B', 'V', 'G', 'D', 'I', 'J', 'Z', 'I', 'Y', 'K', 'L', 'M', 'N', 'A', 'P',
+    'R', 'S', 'T', 'U', 'F', 'H', 'X', 'C', 'W', 'Q', 0, 'A', 0, 'I', 'U', 'A'
+};
+
+/* voiceless pair of a voiced symbol, the symbol itself otherwise */
+static char devoiced(char c) {
+    switch (c) {
+    case 'B': return 'P';
+    case 'V': return 'F';
+    case 'G': return 'K';
+    case 'D': return 'T';
+    case 'J': return 'W';
+    case 'Z': return 'S';
+    default: return c;
+    }
+}
+
+static bool voiceless(char c) {
+    switch (c) {
+    case 'P': case 'F': case 'K': case 'T': case 'W': case 'S': case 'Q': case 'C': case 'X': case 'H':
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* а..я as 0..31 (ё as е), -1 for anything else */
+static int letter(wchar_t c) {
+    if (c >= 0x410 && c <= 0x42f)
+        return c - 0x410;
+    if (c >= 0x430 && c <= 0x44f)
+        return c - 0x430;
+    if (c == 0x401 || c == 0x451)
+        return 5;
+    return -1;
+}
+
+/* symbols of Cyrillic letters are lower case until the end, so the rules below leave Latin letters and digits alone */
+static bool from_cyrillic(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+static char upper(char c) {
+    return from_cyrillic(c) ? c - 'a' + 'A' : c;
+}
+
+size_t ru_phonetic_key(const wchar_t* s, size_t l, char* key) {
+    const int i_letter = 8, short_i = 9, o = 14, ie = 5;
+    size_t n = 0;
+
+    /* letters to symbols, words separated by one space */
+    for (size_t i = 0; i < l; i++) {
+        int c = letter(s[i]);
+        if (c >= 0) {
+            /* йо, ио, йе, ие sound as и */
+            if ((c == i_letter || c == short_i) && i + 1 < l && (letter(s[i + 1]) == o || letter(s[i + 1]) == ie)) {
+                key[n++] = 'i';
+                i++;
+            } else if (cyrillic[c])
+                key[n++] = cyrillic[c] - 'A' + 'a';
+        } else if ((s[i] >= L'a' && s[i] <= L'z') || (s[i] >= L'A' && s[i] <= L'Z') || (s[i] >= L'0' && s[i] <= L'9'))
+            key[n++] = s[i] >= L'a' ? s[i] - L'a' + 'A' : s[i];
+        else if (n && key[n - 1] != ' ')
+            key[n++] = ' ';
+    }
+    if (n && key[n - 1] == ' ')
+        n--;
+
+    /*
+     * devoicing runs right to left, a devoiced consonant devoices the one
+     * before it; a Latin letter or digit ends the word like a space
+     */
+    for (size_t i = n; i-- > 0;)
+        if (from_cyrillic(key[i]) && (i + 1 == n || !from_cyrillic(key[i + 1]) || voiceless(upper(key[i + 1]))))
+            key[i] = devoiced(upper(key[i])) - 'A' + 'a';
+
+    /* тс, дс (after devoicing both TS) to ц; repeated sounds once */
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = key[i];
+        if (c == 't' && i + 1 < n && key[i + 1] == 's') {
+            c = 'x';
+            i++;
+        }
+        if (m && from_cyrillic(c) && key[m - 1] == c)
+            continue;
+        key[m++] = c;
+    }
+    for (size_t i = 0; i < m; i++)
+        key[i] = upper(key[i]);
+    return m;
+}
@@ -0,0 +1,18 @@
+#include <cstddef>
+
+/*
+ * Phonetic key of Russian text, after the rules of the Russian Metaphone
+ * (Petrov): unstressed and iotated vowels reduced to A, I, U, voiced
+ * consonants devoiced before voiceless ones and at the end of a word, soft
+ * and hard signs dropped, ТС/ДС merged into Ц and repeated sounds written
+ * once. The key is ASCII, one symbol per sound and a space between words:
+ *
+ *   A а о ы я   I е ё э и йо ио йе ие   U у ю   Y й
+ *   B б  V в  G г  D д  J ж  Z з    voiced, devoiced to
+ *   P п  F ф  K к  T т  W ш  S с
+ *   Q щ  C ч  X ц  H х  L л  M м  N н  R р
+ *
+ * Latin letters are upper-cased and kept as they are with digits, the
+ * rules above only apply to Cyrillic letters; anything else separates words. key needs room for l characters, its length is returned.
+ */
+size_t ru_phonetic_key(const wchar_t* s, size_t l, char* key);
@@ -0,0 +1,171 @@
+/*
+ * Token-level similarity: strings are split into words on whitespace and
+ * punctuation, every word is hashed to 64 bits and the hashes are kept in a
+ * flat array sorted by value, so set operations are a single linear merge.
+ * The character kernels only see what the token sets can't explain.
+ *
+ * token_jaccard = |A & B| / |A | B| over the word sets
+ * token_sort    = similarity of the words joined in code point order
+ * token_set     = best similarity among intersection, intersection + rest of a
+ *                 and intersection + rest of b (as in fuzzywuzzy)
+ * where similarity = 1 - levenshtein / max length.
+ */
+
+#include "tokens.h"
+#include "levenshtein.h"
+#include "dispatch.h"
+#include <vector>
+#include <algorithm>
+#include <cwctype>
+#include <stdint.h>
+
+using namespace std;
+
+struct token {
+    uint64_t hash;
+    unsigned int pos, len;
+};
+
+static bool hash_less(const token& a, const token& b) {
+    return a.hash < b.hash;
+}
+
+static bool hash_equal(const token& a, const token& b) {
+    return a.hash == b.hash;
+}
+
+static bool is_separator(wchar_t c) {
+    return iswspace(c) || iswpunct(c) || iswcntrl(c);
+}
+
+/* splits s into tokens sorted by hash, duplicates are kept */
+static void tokenize(const wstring& s, vector<token>& tokens) {
+    unsigned int i = 0, n = s.length();
+
+    while (i < n) {
+        while (i < n && is_separator(s[i]))
+            i++;
+        if (i == n)
+            break;
+
+        token t;
+        t.hash = 14695981039346656037ULL; /* FNV-1a */
+        t.pos = i;
+        while (i < n && !is_separator(s[i])) {
+            t.hash = (t.hash ^ (uint32_t)s[i]) * 1099511628211ULL;
+            i++;
+        }
+        t.len = i - t.pos;
+        tokens.push_back(t);
+    }
+    sort(tokens.begin(), tokens.end(), hash_less);
+}
+
+static void tokenize_set(const wstring& s, vector<token>& tokens) {
+    tokenize(s, tokens);
+    tokens.erase(unique(tokens.begin(), tokens.end(), hash_equal), tokens.end());
+}
+
+/* orders tokens of s by their text, hash order moves with every typo */
+struct text_less {
+    const wstring& s;
+    text_less(const wstring& s) : s(s) {}
+    bool operator()(const token& a, const token& b) const {
+        return s.compare(a.pos, a.len, s, b.pos, b.len) < 0;
+    }
+};
+
+/* appends tokens of s to out in text order separated by single spaces */
+static void join(const wstring& s, vector<token> tokens, wstring& out) {
+    sort(tokens.begin(), tokens.end(), text_less(s));
+    for (unsigned int i = 0; i < tokens.size(); i++) {
+        if (!out.empty())
+            out += L' ';
+        out.append(s, tokens[i].pos, tokens[i].len);
+    }
+}
+
+/* levenshtein over what remains after stripping common prefix and suffix */
+static unsigned int residue_levenshtein(const wstring& a, const wstring& b) {
+    size_t p = 0, la = a.length(), lb = b.length();
+
+    while (p < la && p < lb && a[p] == b[p])
+        p++;
+    while (la > p && lb > p && a[la - 1] == b[lb - 1]) {
+        la--;
+        lb--;
+    }
+    if (la == p || lb == p)
+        return (la - p) + (lb - p);
+
+    return levenshtein_dist(a.data() + p, la - p, b.data() + p, lb - p);
+}
+
+static double ratio(const wstring& a, const wstring& b) {
+    size_t l = max(a.length(), b.length());
+
+    if (!l)
+        return 0;
+    return 1.0 - (double)residue_levenshtein(a, b) / (double)l;
+}
+
+double token_jaccard_coeff(const wstring& s1, const wstring& s2) {
+    vector<token> t1, t2;
+
+    tokenize_set(s1, t1);
+    tokenize_set(s2, t2);
+    if (t1.empty() && t2.empty())
+        return 0;
+
+    vector<uint64_t> h1(t1.size()), h2(t2.size());
+    for (size_t i = 0; i < t1.size(); i++)
+        h1[i] = t1[i].hash;
+    for (size_t i = 0; i < t2.size(); i++)
+        h2[i] = t2[i].hash;
+    size_t intersection = kernels().intersect(h1.data(), h1.size(), h2.data(), h2.size());
+
+    return (double)intersection / (double)(t1.size() + t2.size() - intersection);
+}
+
+double token_sort_coeff(const wstring& s1, const wstring& s2) {
+    vector<token> t1, t2;
+    wstring j1, j2;
+
+    tokenize(s1, t1);
+    tokenize(s2, t2);
+    join(s1, t1, j1);
+    join(s2, t2, j2);
+
+    return ratio(j1, j2);
+}
+
+double token_set_coeff(const wstring& s1, const wstring& s2) {
+    vector<token> t1, t2, common, rest1, rest2;
+
+    tokenize_set(s1, t1);
+    tokenize_set(s2, t2);
+    if (t1.empty() || t2.empty())
+        return 0;
+
+    size_t i = 0, j = 0;
+    while (i < t1.size() || j < t2.size()) {
+        if (j == t2.size() || (i < t1.size() && t1[i].hash < t2[j].hash))
+            rest1.push_back(t1[i++]);
+        else if (i == t1.size() || t2[j].hash < t1[i].hash)
+            rest2.push_back(t2[j++]);
+        else {
+            common.push_back(t1[i]);
+            i++;
+            j++;
+        }
+    }
+
+    wstring sorted_common, combined1, combined2;
+    join(s1, common, sorted_common);
+    combined1 = combined2 = sorted_common;
+    join(s1, rest1, combined1);
+    join(s2, rest2, combined2);
+
+    return max(ratio(sorted_common, combined1),
+               max(ratio(sorted_common, combined2), ratio(combined1, combined2)));
+}
@@ -0,0 +1,7 @@
+#include <string>
+
+double token_jaccard_coeff(const std::wstring& s1, const std::wstring& s2);
+
+double token_sort_coeff(const std::wstring& s1, const std::wstring& s2);
+
+double token_set_coeff(const std::wstring& s1, const std::wstring& s2);
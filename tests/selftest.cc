@@ -0,0 +1,221 @@
+/*
+ * Checks of the metrics and kernels, run by ctest. The strings are the
+ * README examples; the UDF layer has its own checks in src/mymetrics.cc.
+ */
+
+/* checks stay on in release builds */
+#undef NDEBUG
+
+#include "levenshtein.h"
+#include "dmetaphone.h"
+#include "jarowinkler.h"
+#include "dice.h"
+#include "tokens.h"
+#include "lsh.h"
+#include "fuzzy.h"
+#include "ruphonetic.h"
+#include "normalize.h"
+#include "alignment.h"
+#include "pack.h"
+#include "cluster.h"
+#include "dispatch.h"
+#include "mymetrics/mymetrics.h"
+
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
+
+using namespace std;
+
+int main(int argc, const char* argv[]) {
+  /* towupper() in the encoders needs a UTF-8 locale, as in the server */
+  if (!setlocale(LC_ALL, "C.UTF-8") && !setlocale(LC_ALL, "en_US.UTF-8")) {
+    fputs("no UTF-8 locale\n", stderr);
+    return 1;
+  }
+
+  assert(levenshtein_dist(L"ООО Рога и копыта", L"Рога и копыта, ООО") == 9);
+  levenshtein_stream stream(L"ООО Рога и копыта", 17);
+  assert(stream.distance(L"Рога и копыта, ООО", 18) == 9);
+  assert(stream.distance(L"Рога и копыта, ОАО", 18, 4) == 5);
+  assert(stream.distance(L"ООО Роза и копыта", 17) == 1);
+  assert(stream.distance(L"ООО Роза", 8, 2) == 3);
+  {
+    /* a long query against a candidate too long to keep the matrix of, then the stream goes on as before */
+    wstring query(100, L'а'), candidate(levenshtein_stream::max_cells / 100, L'а');
+    candidate[5] = L'б';
+    levenshtein_stream long_stream(query.data(), query.size());
+    assert(long_stream.distance(candidate.data(), candidate.size()) == candidate.size() - 100);
+    assert(long_stream.distance(candidate.data(), candidate.size(), 3) == 4);
+    assert(long_stream.distance(query.data(), 90) == 10);
+    assert(long_stream.distance(query.data(), 95, 3) == 4 && long_stream.distance(query.data(), 99, 3) == 1);
+  }
+
+  assert(dmetaphone_eq(L"mère", L"mer"));
+  assert(dmetaphone_eq(L"peke", L"pique"));
+  assert(!dmetaphone_eq(L"bloat", L"float"));
+
+  assert(floor(100 * jaro_winkler_dist(L"ООО Рага и копыта", L"Рога и копыта, ООО")) == 70.0);
+
+  assert(floor(100 * dice_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО")) == 70.0);
+
+  string p1, p2;
+  vector<uint64_t> scratch;
+  dice_profile(L"ООО Рага и копыта", 17, p1);
+  dice_profile(L"Рога и копыта, ООО", 18, p2);
+  assert(dice_profile_coeff(p1.data(), p1.size(), p2.data(), p2.size(), scratch) == dice_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО"));
+  p2.insert(0, "x");
+  assert(dice_profile_coeff(p1.data(), p1.size(), p2.data() + 1, p2.size() - 1, scratch) == dice_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО"));
+  dice_profile(L"a", 1, p1);
+  dice_profile(L"", 0, p2);
+  assert(p1.size() == 4 && dice_profile_coeff(p1.data(), p1.size(), p2.data(), p2.size(), scratch) == 0);
+  assert(std::isnan(dice_profile_coeff(p1.data(), p1.size(), p1.data(), p1.size(), scratch)));
+  assert(dice_profile_coeff(p1.data(), 3, p1.data(), 4, scratch) < 0);
+
+  assert(token_jaccard_coeff(L"ООО Рога и копыта", L"Рога и копыта, ООО") == 1.0);
+  assert(token_sort_coeff(L"ООО Рога и копыта", L"Рога и копыта, ООО") == 1.0);
+  assert(token_set_coeff(L"Рога и копыта", L"Рога и копыта, ООО") == 1.0);
+  assert(floor(100 * token_jaccard_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО")) == 60.0);
+  /* the typo moves smith in hash order, not in text order */
+  assert(fabs(token_sort_coeff(L"smith john robert", L"saith john robert") - 16.0 / 17) < 1e-12);
+  assert(fabs(token_set_coeff(L"smith john robert", L"saith john robert") - 16.0 / 17) < 1e-12);
+
+  uint64_t k1[4], k2[4];
+  minhash_bands(L"Рога и копыта", 2, 4, k1);
+  minhash_bands(L"Рога и копыта", 2, 4, k2);
+  assert(equal(k1, k1 + 4, k2));
+  assert(simhash(L"Рога и копыта", 2) == simhash(L"Рога и копыта", 2));
+  assert(simhash(L"Рога и копыта", 2) != simhash(L"bloat", 2));
+
+
+  assert(kernels().levenshtein_bytes("kitten", 6, "sitting", 7) == 3);
+  assert(kernels().levenshtein_bytes_bounded("kitten", 6, "sitting", 7, 1) == 2);
+  assert(jaro_winkler_bytes("martha", 6, "marhta", 6) == jaro_winkler_dist(L"martha", L"marhta"));
+  assert(dice_coeff_bytes("night", 5, "nacht", 5) == dice_coeff(L"night", L"nacht"));
+  wstring primary, secondary;
+  dmetaphone_prefix(L"Schmidt", 32, primary, secondary);
+  assert(primary == L"XMT" && secondary == L"SMT");
+  assert(dmetaphone_key(primary) == ((uint64_t)14 << 55 | (uint64_t)8 << 50 | (uint64_t)13 << 45));
+  uint64_t peke_key;
+  dmetaphone_prefix(L"peke", 12, primary, secondary);
+  peke_key = dmetaphone_key(primary);
+  dmetaphone_prefix(L"pique", 12, primary, secondary);
+  assert(dmetaphone_key(primary) == peke_key && dmetaphone_key(L"") == 0);
+
+  char key[32], key2[32];
+  assert(string(key, ru_phonetic_key(L"Рога и копыта", 13, key)) == "RAGA I KAPATA");
+  assert(string(key, ru_phonetic_key(L"ООО «Рага и капыта»", 19, key)) == "A RAGA I KAPATA");
+  assert(string(key, ru_phonetic_key(L"Шварценеггер", 12, key)) == string(key2, ru_phonetic_key(L"Шварцэнегер", 11, key2)));
+  assert(string(key, ru_phonetic_key(L"водка", 5, key)) == "VATKA");
+  /* digits and Latin words are kept as written */
+  assert(string(key, ru_phonetic_key(L"Дом 100", 7, key)) == "DAM 100");
+  assert(string(key, ru_phonetic_key(L"Дом 10", 6, key)) == "DAM 10");
+  assert(string(key, ru_phonetic_key(L"2008", 4, key)) == "2008");
+  assert(string(key, ru_phonetic_key(L"BOB JAZZ", 8, key)) == "BOB JAZZ");
+  assert(string(key, ru_phonetic_key(L"дуб5", 4, key)) == "DUP5");
+
+  fuzzy_pattern brand(L"Рога и копыта", 13);
+  assert(brand.contains(L"ООО «Рага и копыто», Москва", 27, 2));
+  assert(!brand.contains(L"ООО «Рага и копыто», Москва", 27, 1));
+  assert(brand.position(L"ООО «Рага и копыто», Москва", 27, 2) == 6);
+  assert(brand.position(L"рога", 4, 20) == 1 && brand.position(L"", 0, 2) == 0);
+  assert(kernels().hamming(L"+7 495 123-45-67", L"+7 495 128-45-76", 16) == 3);
+  assert(kernels().hamming_bytes("0123456789", "0123556789", 10) == 1);
+  assert(kernels().hamming_bits("\xff\x0f", "\x0f\x0f", 2) == 4);
+  assert(kernels().is_ascii("plain text", 10) && !kernels().is_ascii("m\xc3\xa8re", 5));
+
+  wchar_t norm[64];
+  const char mere[] = "  M\xc3\xa8re,  \xd0\x9e\xd0\x9e\xd0\x9e\xc2\xbb ";
+  assert(wstring(norm, normalize_utf8(mere, strlen(mere), NORM_LOWER | NORM_UNACCENT | NORM_LOOKALIKE | NORM_SPACES | NORM_NOPUNCT, norm)) == L"mere ooo");
+  assert(wstring(norm, normalize_utf8(mere, strlen(mere), NORM_TRANSLIT, norm)) == L"  Mère,  OOO» ");
+  assert(wstring(norm, normalize_utf8("\xd0\xa9\xd1\x83\xd0\xba\xd0\xb8\xd0\xbd", 10, NORM_TRANSLIT, norm)) == L"Shchukin");
+  assert(wstring(norm, normalize_latin1("Cr\xe8me br\xfbl\xe9" "e", 12, NORM_UNACCENT | NORM_LOWER, norm)) == L"creme brulee");
+
+  alignment_scoring scoring = { 2, 1, 3, 1 };
+  local_alignment brand_region(L"Рога и копыта", 13, scoring);
+  /* 12 matches and a mismatch in the OCR'd text, nothing around it counts */
+  assert(brand_region.score(L"ООО «Рога и коныта», Москва", 27) == 23);
+  assert(brand_region.score(L"", 0) == 0);
+  /* a gap of one: 12 matches, -3 */
+  assert(brand_region.score(L"xx Рога икопыта xx", 18) == 21);
+
+  char pack_path[] = "/tmp/mymetrics-selftest-XXXXXX";
+  int pack_fd = mkstemp(pack_path);
+  assert(pack_fd >= 0);
+  close(pack_fd);
+  for (int wide = 0; wide < 2; wide++) {
+    pack_builder builder(wide == 1);
+    builder.add(L"ab", 2);
+    builder.add(L"", 0);
+    builder.add(wide ? L"Рога" : L"Mère", 4);
+    assert(builder.write(pack_path));
+
+    corpus_pack pack;
+    string error;
+    assert(pack.open(pack_path, error) && corpus_pack::is_pack(pack_path));
+    assert(pack.size() == 3 && pack.narrow() == !wide && pack.has_bigrams() == (wide == 1));
+    assert(pack.length(1) == 0 && pack.length(2) == 4 && pack.arena_size() == 9);
+    if (wide)
+      assert(wstring(pack.str(2)) == L"Рога" && pack.bigram_count(0) == 1 && pack.bigram_count(2) == 3 &&
+             dice_coeff(pack.str(0), pack.str(2)) == 0);
+    else
+      assert(!strcmp(pack.bytes(0), "ab") && (unsigned char)pack.bytes(2)[1] == 0xe8);
+  }
+  truncate(pack_path, 100);
+  {
+    corpus_pack pack;
+    string error;
+    assert(!pack.open(pack_path, error) && !pack.is_open() && error == "truncated or damaged corpus pack");
+  }
+  unlink(pack_path);
+
+  vector<size_t> leader;
+  leader_clustering by_jw(CLUSTER_JARO_WINKLER, 0.9);
+  by_jw.add(L"Рога и копыта", 13);
+  by_jw.add(L"Мосгаз", 6);
+  by_jw.add(L"Рога и копыто", 13);
+  by_jw.add(L"Рога и копыта ООО", 17);
+  by_jw.add(L"Мосгаз", 6);
+  by_jw.run(leader);
+  /* the longest leads, order of adding doesn't matter */
+  assert(leader[0] == 3 && leader[2] == 3 && leader[3] == 3 && leader[1] == leader[4] && leader[leader[1]] == leader[1]);
+  leader_clustering by_lev(CLUSTER_LEVENSHTEIN, 1);
+  by_lev.add(L"abcd", 4);
+  by_lev.add(L"abc", 3);
+  by_lev.add(L"ab", 2);
+  by_lev.add(L"", 0);
+  by_lev.add(L"", 0);
+  by_lev.run(leader);
+  /* "ab" is 2 away from the leader "abcd", not chained through "abc" */
+  assert(leader[0] == 0 && leader[1] == 0 && leader[2] == 2 && leader[3] == 3 && leader[4] == 3);
+  leader_clustering by_dice(CLUSTER_DICE, 0.5);
+  by_dice.add(L"night", 5);
+  by_dice.add(L"nacht", 5);
+  by_dice.add(L"nights", 6);
+  by_dice.add(L"x", 1);
+  by_dice.add(L"x", 1);
+  by_dice.run(leader);
+  assert(leader[0] == 2 && leader[1] == 1 && leader[2] == 2 && leader[3] == leader[4]);
+  by_dice.clear();
+  by_dice.run(leader);
+  assert(by_dice.size() == 0 && leader.empty());
+
+  mymetrics::scratch buffers;
+  assert(mymetrics::levenshtein("ООО Рога и копыта", "Рога и копыта, ООО", buffers) == 9);
+  assert(mymetrics::levenshtein("kitten", "sitting", 1, buffers) == 2);
+  assert(mymetrics::levenshtein(wstring(L"mère"), wstring(L"mer")) == 2);
+  assert(mymetrics::jaro_winkler("martha", "marhta", buffers) == jaro_winkler_dist(L"martha", L"marhta"));
+  assert(mymetrics::dice("ООО Рага и копыта", "Рога и копыта, ООО", buffers) == dice_coeff(L"ООО Рага и копыта", L"Рога и копыта, ООО"));
+  assert(mymetrics::double_metaphone_eq(wstring(L"peke"), wstring(L"pique")));
+  assert(mymetrics::hamming(wstring(L"abc"), wstring(L"abd")) == 1 && mymetrics::hamming(wstring(L"abc"), wstring(L"ab")) == -1);
+  assert(mymetrics::hamming_bits("\xff", 1, "\x00", 1) == 8);
+  assert(!strcmp(mymetrics::isa(), kernels().name));
+#if __cplusplus >= 201703L
+  assert(mymetrics::levenshtein(std::u32string_view(U"ООО"), std::u32string_view(U"ОАО")) == 1);
+#endif
+  return 0;
+}
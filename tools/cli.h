@@ -0,0 +1,110 @@
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdio>
+#include <mutex>
+#include "pack.h"
+
+/* commands, argv[0] is the command name */
+int score_main(int argc, char **argv);
+int edjoin_main(int argc, char **argv);
+int setjoin_main(int argc, char **argv);
+int matrix_main(int argc, char **argv);
+int pack_main(int argc, char **argv);
+
+void die(const char *fmt, ...);
+
+unsigned int default_threads();
+
+/* UTF-8 bytes to code points, reusing the capacity of ws */
+void decode(const char *s, size_t l, std::wstring& ws);
+
+/* a run of whole lines of the input */
+struct chunk {
+    size_t seq;
+    size_t first_line;   /* number of lines before it */
+    const char *begin, *end;
+    std::string data;    /* owns the lines when the input is not mapped */
+    std::string out;
+};
+
+/* input file mapped into memory, read in blocks when it can't be (pipes, "-" for stdin) */
+class input {
+  public:
+    explicit input(const char *path);
+    ~input();
+
+    /* next chunk of about block_size bytes, false at the end */
+    bool next(chunk& c);
+
+    static const size_t block_size = 4 << 20;
+
+  private:
+    int fd;
+    const char *map;
+    size_t size, pos, lines;
+    std::string carry;
+    bool eof;
+};
+
+/* iterates lines of [p, end), line ends are stripped */
+bool next_line(const char *&p, const char *end, const char *&b, const char *&e);
+
+struct field {
+    const char *s;
+    size_t l;
+};
+
+/* splits a line on delim, quoted fields (CSV) are unquoted into scratch */
+void split_fields(const char *b, const char *e, char delim, std::vector<field>& fields, std::string& scratch);
+
+typedef std::function<void(unsigned int worker, chunk& c)> chunk_work;
+
+/*
+ * The calling thread reads chunks, `threads` workers run work on them and a
+ * writer thread outputs chunk.out in input order. At most a few chunks per
+ * worker are in flight, so memory stays bounded on any input size.
+ */
+void run_pipeline(input& in, FILE *out, unsigned int threads, const chunk_work& work);
+
+/*
+ * Runs task(worker, i) for every i < n on `threads` workers. Each worker
+ * starts on its own contiguous share and, when it runs dry, steals half of
+ * what is left of the fullest other share, so skewed tasks still balance.
+ */
+void parallel_for(size_t n, unsigned int threads, const std::function<void(unsigned int worker, size_t i)>& task);
+
+/*
+ * First field of every line decoded into one NUL separated code point
+ * arena. From a corpus pack the offsets, and the code points of a wide
+ * pack, are read in place.
+ */
+struct corpus {
+    std::vector<wchar_t> chars;
+    std::vector<uint64_t> offsets;
+    corpus_pack pack;
+    const wchar_t *arena;
+    const uint64_t *starts;
+    size_t count;
+
+    corpus() : arena(0), starts(0), count(0) {}
+    size_t size() const { return count; }
+    const wchar_t *str(size_t i) const { return arena + starts[i]; }
+    size_t length(size_t i) const { return starts[i + 1] - starts[i] - 1; }
+    size_t code_points() const { return starts[count] - count; }
+};
+
+/* a file made by `mymetrics-cli pack` is mapped instead of parsed, delim doesn't matter then */
+void load_corpus(const char *path, char delim, corpus& c);
+
+/* output shared by workers, each flushes its own buffer when it is big enough */
+class shared_output {
+  public:
+    explicit shared_output(const char *path);
+    ~shared_output();
+    void flush(std::string& buf, bool force = false);
+
+  private:
+    FILE *out;
+    std::mutex mx;
+};
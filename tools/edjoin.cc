@@ -0,0 +1,215 @@
+/*
+ * mymetrics-cli edjoin: all pairs within edit distance k, Pass-Join style
+ * (Li, Deng, Wang, Feng, "Pass-Join: A Partition-based Method for Similarity
+ * Joins", VLDB 2012).
+ *
+ * Every indexed string of length l >= k + 1 is cut into k + 1 segments; two
+ * strings within distance k share at least one segment, found at a shifted
+ * position that multi-match-aware selection narrows to a few substrings of
+ * the probe. Candidates are verified with the bounded levenshtein kernel.
+ * Strings shorter than k + 1 have empty segments and are compared directly.
+ *
+ * One file: self join, pairs are reported once. Two files: every line of
+ * the first against every line of the second. Output lines are
+ * line1 <tab> line2 <tab> distance.
+ */
+
+#include "cli.h"
+#include "dispatch.h"
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct entry {
+    uint64_t key;
+    uint32_t rank;
+};
+
+bool entry_less(const entry& a, const entry& b) {
+    return a.key < b.key || (a.key == b.key && a.rank < b.rank);
+}
+
+bool key_less(const entry& a, uint64_t key) {
+    return a.key < key;
+}
+
+uint64_t segment_key(size_t length, unsigned int segment, const wchar_t *s, size_t l) {
+    uint64_t h = 14695981039346656037ULL ^ ((uint64_t)length << 8 | segment);
+    for (size_t i = 0; i < l; i++)
+        h = (h ^ (uint32_t)s[i]) * 1099511628211ULL;
+    return h;
+}
+
+/*
+ * Every character of a missing from b costs at least one edit, so the count
+ * of bits set only in one of the hashed sets is a lower bound of the distance.
+ */
+uint64_t char_set(const wchar_t *s, size_t l) {
+    uint64_t set = 0;
+    for (size_t i = 0; i < l; i++)
+        set |= 1ULL << (((uint32_t)s[i] * 0x9E3779B1U) >> 26);
+    return set;
+}
+
+/* start of segment i (0-based) of a string of length l cut in parts */
+size_t segment_start(size_t l, unsigned int parts, unsigned int i) {
+    size_t base = l / parts, shorter = parts - l % parts;
+    return i <= shorter ? i * base : shorter * base + (i - shorter) * (base + 1);
+}
+
+/* strings of one side of the join ordered by length, probes only see lower ranks in a self join */
+struct side {
+    corpus text;
+    vector<uint32_t> order;      /* rank -> line */
+    vector<size_t> by_length;    /* first rank of every length, one past the longest at the end */
+    vector<entry> index;
+    vector<uint64_t> chars;      /* rank -> set of characters hashed to 64 bits */
+
+    void prepare(unsigned int k, bool build_index) {
+        size_t n = text.size();
+        order.resize(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = i;
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return text.length(a) < text.length(b);
+        });
+
+        size_t longest = n ? text.length(order[n - 1]) : 0;
+        by_length.assign(longest + 2, n);
+        for (size_t r = n; r-- > 0;)
+            by_length[text.length(order[r])] = r;
+        for (size_t l = longest; l-- > 0;)
+            by_length[l] = min(by_length[l], by_length[l + 1]);
+
+        chars.resize(n);
+        for (size_t r = 0; r < n; r++)
+            chars[r] = char_set(text.str(order[r]), text.length(order[r]));
+
+        if (!build_index)
+            return;
+        for (size_t r = by_length[min(longest + 1, (size_t)k + 1)]; r < n; r++) {
+            const wchar_t *s = text.str(order[r]);
+            size_t l = text.length(order[r]);
+            for (unsigned int i = 0; i <= k; i++) {
+                size_t from = segment_start(l, k + 1, i), to = segment_start(l, k + 1, i + 1);
+                entry e = { segment_key(l, i, s + from, to - from), (uint32_t)r };
+                index.push_back(e);
+            }
+        }
+        sort(index.begin(), index.end(), entry_less);
+    }
+
+    size_t first_of_length(size_t l) const {
+        return l < by_length.size() ? by_length[l] : order.size();
+    }
+};
+
+/* ranks of indexed strings of length l that may be within k of s */
+void probe(const side& r, const wchar_t *s, size_t ls, size_t l, unsigned int k, size_t below, vector<uint32_t>& cands) {
+    long delta = (long)ls - (long)l;
+
+    for (unsigned int i = 0; i <= k; i++) {
+        long start = segment_start(l, k + 1, i), len = segment_start(l, k + 1, i + 1) - start;
+        long lo = max(start - (long)i, start + delta - (long)(k - i));
+        long hi = min(start + (long)i, start + delta + (long)(k - i));
+        lo = max(lo, 0L);
+        hi = min(hi, (long)ls - len);
+
+        for (long p = lo; p <= hi; p++) {
+            uint64_t key = segment_key(l, i, s + p, len);
+            vector<entry>::const_iterator it = lower_bound(r.index.begin(), r.index.end(), key, key_less);
+            for (; it != r.index.end() && it->key == key && it->rank < below; ++it)
+                cands.push_back(it->rank);
+        }
+    }
+}
+
+void usage() {
+    fputs("usage: mymetrics-cli edjoin -k max-distance [-d delimiter] [-j threads] [-o output] file [file2]\n"
+          "prints line1 <tab> line2 <tab> distance for every pair within the distance\n", stderr);
+    exit(1);
+}
+
+}
+
+int edjoin_main(int argc, char **argv) {
+    const char *output = 0;
+    char delim = '\t';
+    unsigned int threads = default_threads();
+    int k = -1, opt;
+
+    while ((opt = getopt(argc, argv, "k:d:j:o:")) != -1) {
+        switch (opt) {
+        case 'k': k = atoi(optarg); break;
+        case 'd': delim = optarg[0]; break;
+        case 'j': threads = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'o': output = optarg; break;
+        default: usage();
+        }
+    }
+    if (k < 0 || optind >= argc || optind + 2 < argc)
+        usage();
+
+    bool self = optind + 1 == argc;
+    side r, s_side;
+    load_corpus(argv[optind], delim, r.text);
+    r.prepare(k, true);
+    const side& s = self ? r : s_side;
+    if (!self) {
+        load_corpus(argv[optind + 1], delim, s_side.text);
+        s_side.prepare(k, false);
+    }
+
+    shared_output out(output);
+    vector<vector<uint32_t> > cands(threads);
+    vector<string> bufs(threads);
+
+    parallel_for(s.order.size(), threads, [&](unsigned int w, size_t rank) {
+        vector<uint32_t>& c = cands[w];
+        string& buf = bufs[w];
+        size_t line = s.order[rank];
+        const wchar_t *str = s.text.str(line);
+        size_t ls = s.text.length(line);
+        size_t shortest = ls > (size_t)k ? ls - k : 0;
+        size_t longest = self ? ls : ls + k;
+        size_t below = self ? rank : r.order.size();
+        char num[80];
+
+        c.clear();
+        for (size_t l = shortest; l <= longest; l++) {
+            if (l > (size_t)k) {
+                probe(r, str, ls, l, k, below, c);
+            } else {
+                size_t to = min(r.first_of_length(l + 1), below);
+                for (size_t i = r.first_of_length(l); i < to; i++)
+                    c.push_back(i);
+            }
+        }
+        sort(c.begin(), c.end());
+        c.erase(unique(c.begin(), c.end()), c.end());
+
+        uint64_t set = s.chars[rank];
+        for (size_t i = 0; i < c.size(); i++) {
+            uint64_t other_set = r.chars[c[i]];
+            if (__builtin_popcountll(set & ~other_set) > k || __builtin_popcountll(other_set & ~set) > k)
+                continue;
+            size_t other = r.order[c[i]];
+            unsigned int d = kernels().levenshtein_bounded(r.text.str(other), r.text.length(other), str, ls, k);
+            if (d > (unsigned int)k)
+                continue;
+            size_t a = other + 1, b = line + 1;
+            if (self && a > b)
+                swap(a, b);
+            buf.append(num, snprintf(num, sizeof(num), "%zu\t%zu\t%u\n", a, b, d));
+        }
+        out.flush(buf);
+    });
+
+    for (unsigned int w = 0; w < threads; w++)
+        out.flush(bufs[w], true);
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "cli.h"
+#include "dispatch.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdarg>
+#include <cstdlib>
+#include <cerrno>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+void die(const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("mymetrics-cli: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    exit(1);
+}
+
+unsigned int default_threads() {
+    unsigned int n = thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void decode(const char *s, size_t l, wstring& ws) {
+    ws.resize(l);
+    ws.resize(kernels().utf8_decode(s, l, &ws[0]));
+}
+
+input::input(const char *path) : fd(0), map(0), size(0), pos(0), lines(0), eof(false) {
+    struct stat st;
+
+    if (strcmp(path, "-") && (fd = open(path, O_RDONLY)) < 0)
+        die("can't open %s: %s", path, strerror(errno));
+
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            map = (const char*)m;
+            size = st.st_size;
+            madvise(m, size, MADV_SEQUENTIAL);
+        }
+    }
+}
+
+input::~input() {
+    if (map)
+        munmap((void*)map, size);
+    if (fd)
+        close(fd);
+}
+
+bool input::next(chunk& c) {
+    if (map) {
+        if (pos == size)
+            return false;
+        const char *b = map + pos;
+        const char *e = map + min(size, pos + block_size);
+        const char *nl = (const char*)memchr(e - 1, '\n', map + size - (e - 1));
+        e = nl ? nl + 1 : map + size;
+        c.begin = b;
+        c.end = e;
+        pos = e - map;
+    } else {
+        if (eof && carry.empty())
+            return false;
+        c.data.swap(carry);
+        carry.clear();
+        /* the carry has no newline; a block without one grows until a line ends, so no line is split */
+        size_t have = c.data.size(), scanned = have;
+        for (;;) {
+            c.data.resize(have + block_size);
+            while (!eof && have < c.data.size()) {
+                ssize_t r = read(fd, &c.data[have], c.data.size() - have);
+                if (r < 0 && errno == EINTR)
+                    continue;
+                if (r < 0)
+                    die("read error: %s", strerror(errno));
+                if (!r)
+                    eof = true;
+                have += r;
+            }
+            c.data.resize(have);
+            if (eof || c.data.find('\n', scanned) != string::npos)
+                break;
+            scanned = have;
+        }
+        size_t last = c.data.rfind('\n');
+        if (!eof && last != string::npos) {
+            carry.assign(c.data, last + 1, string::npos);
+            c.data.resize(last + 1);
+        }
+        if (c.data.empty())
+            return false;
+        c.begin = c.data.data();
+        c.end = c.begin + c.data.size();
+    }
+
+    c.first_line = lines;
+    lines += count(c.begin, c.end, '\n') + (c.end[-1] != '\n');
+    return true;
+}
+
+bool next_line(const char *&p, const char *end, const char *&b, const char *&e) {
+    if (p >= end)
+        return false;
+
+    const char *nl = (const char*)memchr(p, '\n', end - p);
+    b = p;
+    e = nl ? nl : end;
+    p = nl ? nl + 1 : end;
+    if (e > b && e[-1] == '\r')
+        e--;
+    return true;
+}
+
+void split_fields(const char *b, const char *e, char delim, vector<field>& fields, string& scratch) {
+    fields.clear();
+    scratch.clear();
+    scratch.reserve(e - b);
+
+    for (const char *p = b;;) {
+        field f;
+        if (delim == ',' && p < e && *p == '"') {
+            size_t start = scratch.size();
+            for (p++; p < e; p++) {
+                if (*p == '"') {
+                    if (p + 1 < e && p[1] == '"')
+                        p++;
+                    else {
+                        p++;
+                        break;
+                    }
+                }
+                scratch += *p;
+            }
+            f.s = scratch.data() + start;
+            f.l = scratch.size() - start;
+            p = (const char*)memchr(p, delim, e - p);
+        } else {
+            const char *d = (const char*)memchr(p, delim, e - p);
+            f.s = p;
+            f.l = (d ? d : e) - p;
+            p = d;
+        }
+        fields.push_back(f);
+        if (!p)
+            break;
+        p++;
+    }
+}
+
+void load_corpus(const char *path, char delim, corpus& c) {
+    chunk ch;
+    vector<field> fields;
+    string scratch;
+
+    c.chars.clear();
+    c.offsets.clear();
+    if (strcmp(path, "-") && corpus_pack::is_pack(path)) {
+        if (!c.pack.open(path, scratch))
+            die("%s: %s", path, scratch.c_str());
+        c.count = c.pack.size();
+        c.starts = c.pack.offsets();
+        if (c.pack.narrow()) {
+            const unsigned char *b = (const unsigned char*)c.pack.bytes(0);
+            c.chars.assign(b, b + c.pack.arena_size());
+            c.arena = c.chars.data();
+        } else {
+            c.arena = c.pack.str(0);
+        }
+        return;
+    }
+
+    input in(path);
+    c.offsets.assign(1, 0);
+    while (in.next(ch)) {
+        const char *p = ch.begin, *b, *e;
+        while (next_line(p, ch.end, b, e)) {
+            split_fields(b, e, delim, fields, scratch);
+            size_t at = c.chars.size();
+            c.chars.resize(at + fields[0].l + 1);
+            at += kernels().utf8_decode(fields[0].s, fields[0].l, &c.chars[at]);
+            c.chars[at++] = 0;
+            c.chars.resize(at);
+            c.offsets.push_back(at);
+        }
+    }
+    c.arena = c.chars.data();
+    c.starts = c.offsets.data();
+    c.count = c.offsets.size() - 1;
+}
+
+shared_output::shared_output(const char *path) : out(path ? fopen(path, "w") : stdout) {
+    if (!out)
+        die("can't write %s", path);
+}
+
+shared_output::~shared_output() {
+    if (out != stdout)
+        fclose(out);
+    else
+        fflush(out);
+}
+
+void shared_output::flush(string& buf, bool force) {
+    if (buf.size() < (1 << 20) && !force)
+        return;
+    lock_guard<mutex> lock(mx);
+    fwrite(buf.data(), 1, buf.size(), out);
+    buf.clear();
+}
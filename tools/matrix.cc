@@ -0,0 +1,188 @@
+/*
+ * mymetrics-cli matrix: jaro_winkler or levenshtein of every pair of lines,
+ * the input of hierarchical clustering.
+ *
+ * The lines are decoded once into the corpus arena and ordered by length,
+ * so the batched kernels find candidates of similar length to share their
+ * lanes. The upper triangle of that order is cut into square tiles whose
+ * columns fit in the L2 cache; every row of a tile is scored against the
+ * tile's columns in one batched call, and tiles are spread over the workers
+ * with work stealing.
+ *
+ * Without a threshold the whole matrix is written to the output file as n x n
+ * floats in native byte order, row i for line i + 1, through a shared
+ * mapping. With -t only the pairs reaching it (jaro_winkler >= t,
+ * levenshtein <= t) are printed as line1 <tab> line2 <tab> score.
+ */
+
+#include "cli.h"
+#include "levenshtein.h"
+#include "jarowinkler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+const double eps = 1e-9;
+
+/* code points of the columns of one tile, 128 KB of wchar_t */
+const size_t tile_chars = 32 << 10;
+
+struct tile {
+    uint32_t row, col;    /* first ranks */
+};
+
+/* scores of one row of a tile */
+struct row_buffers {
+    vector<double> similarity;
+    vector<unsigned int> distance;
+    string out;
+};
+
+void usage() {
+    fputs("usage: mymetrics-cli matrix [-m jaro_winkler|levenshtein] [-t threshold] [-d delimiter] [-j threads] [-o output] file\n"
+          "writes the n x n float matrix of the lines to output (required then), or with -t\n"
+          "prints line1 <tab> line2 <tab> score for every pair reaching the threshold\n", stderr);
+    exit(1);
+}
+
+}
+
+int matrix_main(int argc, char **argv) {
+    const char *output = 0;
+    char delim = '\t';
+    unsigned int threads = default_threads();
+    bool use_levenshtein = false, sparse = false;
+    double t = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:d:j:o:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (!strcmp(optarg, "jaro_winkler"))
+                use_levenshtein = false;
+            else if (!strcmp(optarg, "levenshtein"))
+                use_levenshtein = true;
+            else
+                usage();
+            break;
+        case 't': t = atof(optarg); sparse = true; break;
+        case 'd': delim = optarg[0]; break;
+        case 'j': threads = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'o': output = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind + 1 != argc || (!sparse && !output) || (sparse && t < 0))
+        usage();
+
+    corpus text;
+    load_corpus(argv[optind], delim, text);
+    const size_t n = text.size();
+
+    vector<uint32_t> order(n);        /* rank -> line */
+    vector<const wchar_t*> ptrs(n);
+    vector<size_t> lens(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return text.length(a) < text.length(b);
+    });
+    for (size_t r = 0; r < n; r++) {
+        ptrs[r] = text.str(order[r]);
+        lens[r] = text.length(order[r]);
+    }
+
+    size_t average = n ? text.code_points() / n : 0;
+    size_t side = max<size_t>(32, min<size_t>(1024, tile_chars / (average + 1)));
+    size_t blocks = (n + side - 1) / side;
+    vector<tile> tiles;
+    for (size_t i = 0; i < blocks; i++)
+        for (size_t j = i; j < blocks; j++) {
+            tile tl = { (uint32_t)(i * side), (uint32_t)(j * side) };
+            tiles.push_back(tl);
+        }
+
+    float *matrix = 0;
+    size_t bytes = n * n * sizeof(float);
+    if (!sparse) {
+        int fd = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            die("can't write %s: %s", output, strerror(errno));
+        if (ftruncate(fd, bytes))
+            die("can't grow %s to %zu bytes: %s", output, bytes, strerror(errno));
+        if (bytes) {
+            void *m = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (m == MAP_FAILED)
+                die("can't map %s: %s", output, strerror(errno));
+            matrix = (float*)m;
+        }
+        close(fd);
+
+        float self_score = use_levenshtein ? 0 : 1;
+        for (size_t i = 0; i < n; i++)
+            matrix[i * n + i] = self_score;
+    }
+
+    shared_output *out = sparse ? new shared_output(output) : 0;
+    vector<row_buffers> bufs(threads);
+
+    parallel_for(tiles.size(), threads, [&](unsigned int w, size_t k) {
+        row_buffers& b = bufs[w];
+        const tile& tl = tiles[k];
+        size_t row_end = min(n, (size_t)tl.row + side), col_end = min(n, (size_t)tl.col + side);
+        char num[80];
+
+        b.similarity.resize(side);
+        b.distance.resize(side);
+        for (size_t r = tl.row; r < row_end; r++) {
+            /* a tile on the diagonal only has the columns after the row */
+            size_t from = max<size_t>(tl.col, r + 1);
+            if (from >= col_end)
+                continue;
+            size_t count = col_end - from;
+            if (use_levenshtein) {
+                levenshtein_dist_many(ptrs[r], lens[r], &ptrs[from], &lens[from], count, &b.distance[0]);
+                for (size_t c = 0; c < count; c++)
+                    b.similarity[c] = b.distance[c];
+            } else {
+                jaro_winkler_dist_many(ptrs[r], lens[r], &ptrs[from], &lens[from], count, &b.similarity[0]);
+            }
+
+            size_t x = order[r];
+            for (size_t c = 0; c < count; c++) {
+                double v = b.similarity[c];
+                size_t y = order[from + c];
+                if (!sparse) {
+                    matrix[x * n + y] = matrix[y * n + x] = v;
+                    continue;
+                }
+                if (use_levenshtein ? v > t : v < t - eps)
+                    continue;
+                size_t a = min(x, y) + 1, e = max(x, y) + 1;
+                if (use_levenshtein)
+                    b.out.append(num, snprintf(num, sizeof(num), "%zu\t%zu\t%u\n", a, e, b.distance[c]));
+                else
+                    b.out.append(num, snprintf(num, sizeof(num), "%zu\t%zu\t%.6g\n", a, e, v));
+            }
+        }
+        if (out)
+            out->flush(b.out);
+    });
+
+    if (out) {
+        for (unsigned int w = 0; w < threads; w++)
+            out->flush(bufs[w].out, true);
+        delete out;
+    }
+    if (matrix)
+        munmap(matrix, bytes);
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Offline batch tool over the same kernels as the UDF library.
+ */
+
+#include "cli.h"
+#include <clocale>
+#include <cstring>
+#include <cstdlib>
+
+struct command {
+    const char *name;
+    int (*run)(int argc, char **argv);
+    const char *summary;
+};
+
+static const command commands[] = {
+    { "score", score_main, "metrics of pairs, or of queries against candidates" },
+    { "edjoin", edjoin_main, "all pairs within an edit distance (Pass-Join)" },
+    { "setjoin", setjoin_main, "all pairs with dice or Jaccard of bigrams above a threshold (PPJoin)" },
+    { "matrix", matrix_main, "jaro_winkler or levenshtein of every pair, dense or above a threshold" },
+    { "pack", pack_main, "lines decoded once into a corpus pack the other commands map" },
+};
+
+int main(int argc, char **argv) {
+    /* the kernels decode UTF-8 themselves, the locale is for case and character classes */
+    if (!setlocale(LC_ALL, "") || !strcmp("C", setlocale(LC_ALL, 0)))
+        if (!setlocale(LC_ALL, "C.UTF-8"))
+            setlocale(LC_ALL, "en_US.UTF-8");
+
+    if (argc > 1)
+        for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+            if (!strcmp(argv[1], commands[i].name))
+                return commands[i].run(argc - 1, argv + 1);
+
+    fputs("usage: mymetrics-cli command [options]\n", stderr);
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+        fprintf(stderr, "  %-10s %s\n", commands[i].name, commands[i].summary);
+    return 1;
+}
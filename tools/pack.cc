@@ -0,0 +1,61 @@
+/*
+ * mymetrics-cli pack: the first field of every line decoded once into a
+ * corpus pack (src/pack.h), which edjoin, setjoin and matrix then map
+ * instead of parsing. With -b the bigram sets setjoin and dice compare are
+ * stored too.
+ */
+
+#include "cli.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+void usage() {
+    fputs("usage: mymetrics-cli pack [-b] [-d delimiter] -o output file\n"
+          "decodes the first field of every line into a corpus pack, -b adds the bigram sets\n", stderr);
+    exit(1);
+}
+
+}
+
+int pack_main(int argc, char **argv) {
+    const char *output = 0;
+    char delim = '\t';
+    bool bigrams = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bd:o:")) != -1) {
+        switch (opt) {
+        case 'b': bigrams = true; break;
+        case 'd': delim = optarg[0]; break;
+        case 'o': output = optarg; break;
+        default: usage();
+        }
+    }
+    if (!output || optind + 1 != argc)
+        usage();
+
+    pack_builder pack(bigrams);
+    input in(argv[optind]);
+    chunk c;
+    vector<field> fields;
+    string scratch;
+    wstring ws;
+
+    while (in.next(c)) {
+        const char *p = c.begin, *b, *e;
+        while (next_line(p, c.end, b, e)) {
+            split_fields(b, e, delim, fields, scratch);
+            decode(fields[0].s, fields[0].l, ws);
+            pack.add(ws.data(), ws.size());
+        }
+    }
+    if (!pack.write(output))
+        die("can't write %s: %s", output, strerror(errno));
+    return 0;
+}
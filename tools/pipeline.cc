@@ -0,0 +1,91 @@
+#include "cli.h"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+using namespace std;
+
+void run_pipeline(input& in, FILE *out, unsigned int threads, const chunk_work& work) {
+    mutex mx;
+    condition_variable can_take, can_write, can_read;
+    deque<chunk*> todo;
+    map<size_t, chunk*> done;
+    size_t inflight = 0, next_write = 0;
+    const size_t max_inflight = 4 * threads;
+    bool eof = false;
+    vector<thread> workers;
+
+    for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(thread([&, i] {
+            for (;;) {
+                chunk *c;
+                {
+                    unique_lock<mutex> lock(mx);
+                    can_take.wait(lock, [&] { return !todo.empty() || eof; });
+                    if (todo.empty())
+                        return;
+                    c = todo.front();
+                    todo.pop_front();
+                }
+                work(i, *c);
+                {
+                    lock_guard<mutex> lock(mx);
+                    done[c->seq] = c;
+                }
+                can_write.notify_one();
+            }
+        }));
+
+    thread writer([&] {
+        for (;;) {
+            chunk *c;
+            {
+                unique_lock<mutex> lock(mx);
+                can_write.wait(lock, [&] { return done.count(next_write) || (eof && !inflight); });
+                if (!done.count(next_write))
+                    return;
+                c = done[next_write];
+                done.erase(next_write++);
+            }
+            fwrite(c->out.data(), 1, c->out.size(), out);
+            delete c;
+            {
+                lock_guard<mutex> lock(mx);
+                inflight--;
+            }
+            can_read.notify_one();
+        }
+    });
+
+    for (size_t seq = 0;; seq++) {
+        {
+            unique_lock<mutex> lock(mx);
+            can_read.wait(lock, [&] { return inflight < max_inflight; });
+        }
+        chunk *c = new chunk;
+        c->seq = seq;
+        if (!in.next(*c)) {
+            delete c;
+            break;
+        }
+        {
+            lock_guard<mutex> lock(mx);
+            todo.push_back(c);
+            inflight++;
+        }
+        can_take.notify_one();
+    }
+
+    {
+        lock_guard<mutex> lock(mx);
+        eof = true;
+    }
+    can_take.notify_all();
+    can_write.notify_all();
+    for (unsigned int i = 0; i < threads; i++)
+        workers[i].join();
+    writer.join();
+    fflush(out);
+}
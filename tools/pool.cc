@@ -0,0 +1,70 @@
+#include "cli.h"
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+/* the range of tasks a worker still has, [next, end) */
+struct share {
+    mutex mx;
+    size_t next, end;
+};
+
+}
+
+void parallel_for(size_t n, unsigned int threads, const function<void(unsigned int worker, size_t i)>& task) {
+    vector<share> shares(threads);
+    vector<thread> workers;
+
+    for (unsigned int w = 0; w < threads; w++) {
+        shares[w].next = n * w / threads;
+        shares[w].end = n * (w + 1) / threads;
+    }
+
+    for (unsigned int w = 0; w < threads; w++)
+        workers.push_back(thread([&, w] {
+            share& own = shares[w];
+            for (;;) {
+                size_t i;
+                {
+                    lock_guard<mutex> lock(own.mx);
+                    i = own.next < own.end ? own.next++ : n;
+                }
+                if (i < n) {
+                    task(w, i);
+                    continue;
+                }
+
+                /* steal the back half of the biggest remaining share */
+                unsigned int victim = w;
+                size_t most = 0;
+                for (unsigned int v = 0; v < threads; v++) {
+                    lock_guard<mutex> lock(shares[v].mx);
+                    if (shares[v].end - shares[v].next > most) {
+                        most = shares[v].end - shares[v].next;
+                        victim = v;
+                    }
+                }
+                if (!most)
+                    return;
+
+                size_t from, to;
+                {
+                    lock_guard<mutex> lock(shares[victim].mx);
+                    size_t left = shares[victim].end - shares[victim].next;
+                    if (!left)
+                        continue;
+                    to = shares[victim].end;
+                    from = to - (left + 1) / 2;
+                    shares[victim].end = from;
+                }
+                lock_guard<mutex> lock(own.mx);
+                own.next = from;
+                own.end = to;
+            }
+        }));
+
+    for (unsigned int w = 0; w < threads; w++)
+        workers[w].join();
+}
@@ -0,0 +1,265 @@
+/*
+ * mymetrics-cli score: metrics of pairs of strings.
+ *
+ * Pairs mode reads lines with two fields and prints every line followed by
+ * its scores. Query mode (-q) scores every query against every line of the
+ * candidate file and prints query line, candidate line and the scores.
+ * A metric given with a threshold drops the pairs that don't reach it:
+ * distance at most t for levenshtein, similarity at least t otherwise.
+ */
+
+#include "cli.h"
+#include "dispatch.h"
+#include "jarowinkler.h"
+#include "levenshtein.h"
+#include "dice.h"
+#include "dmetaphone.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+enum metric_id { LEVENSHTEIN, JARO_WINKLER, DICE, DMETAPHONE_EQ };
+
+static const char *metric_names[] = { "levenshtein", "jaro_winkler", "dice", "dmetaphone_eq" };
+
+struct metric {
+    metric_id id;
+    bool bounded;
+    double threshold;
+};
+
+static void parse_metrics(const char *spec, vector<metric>& metrics) {
+    string list(spec);
+    size_t start = 0;
+
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        string item = list.substr(start, comma == string::npos ? string::npos : comma - start);
+        size_t colon = item.find(':');
+        string name = item.substr(0, colon);
+        metric m;
+        unsigned int i;
+
+        for (i = 0; i < sizeof(metric_names) / sizeof(metric_names[0]); i++)
+            if (name == metric_names[i])
+                break;
+        if (i == sizeof(metric_names) / sizeof(metric_names[0]))
+            die("unknown metric '%s'", name.c_str());
+        m.id = (metric_id)i;
+        m.bounded = colon != string::npos;
+        m.threshold = m.bounded ? atof(item.c_str() + colon + 1) : 0;
+        metrics.push_back(m);
+
+        if (comma == string::npos)
+            break;
+        start = comma + 1;
+    }
+}
+
+/* metric m of one pair */
+static double score(const metric& m, const wstring& a, const wstring& b) {
+    switch (m.id) {
+    case LEVENSHTEIN:
+        return kernels().levenshtein(a.data(), a.size(), b.data(), b.size());
+    case JARO_WINKLER:
+        return jaro_winkler_dist(a.data(), a.size(), b.data(), b.size());
+    case DICE:
+        return dice_coeff(a, b);
+    default:
+        return dmetaphone_eq(a, b);
+    }
+}
+
+/* appends delim and the scores v[0], v[stride], ... to out, nothing if a threshold fails */
+static bool append_scores(const vector<metric>& metrics, const double *v, size_t stride, char delim, string& out) {
+    char buf[64];
+    size_t mark = out.size();
+
+    for (size_t i = 0; i < metrics.size(); i++) {
+        const metric& m = metrics[i];
+        double x = v[i * stride];
+        bool pass = m.id == LEVENSHTEIN ? x <= m.threshold : x >= m.threshold;
+
+        if (m.bounded && !pass) {
+            out.resize(mark);
+            return false;
+        }
+        out += delim;
+        out.append(buf, snprintf(buf, sizeof(buf), "%.*g", m.id == LEVENSHTEIN ? 10 : 6, x));
+    }
+    return true;
+}
+
+static void usage() {
+    fputs("usage: mymetrics-cli score [-m metric[:threshold],...] [-d delimiter] [-j threads] [-o output]\n"
+          "                           (pairs-file | -q queries-file candidates-file)\n"
+          "metrics: levenshtein (distance, keeps <= threshold), jaro_winkler, dice,\n"
+          "         dmetaphone_eq (similarity, keeps >= threshold); default jaro_winkler\n"
+          "pairs-file lines are a<delim>b, default delimiter is tab, ',' reads quoted CSV fields\n", stderr);
+    exit(1);
+}
+
+int score_main(int argc, char **argv) {
+    vector<metric> metrics;
+    const char *queries = 0, *output = 0;
+    char delim = '\t';
+    unsigned int threads = default_threads();
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:d:j:o:q:")) != -1) {
+        switch (opt) {
+        case 'm': parse_metrics(optarg, metrics); break;
+        case 'd': delim = optarg[0]; break;
+        case 'j': threads = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'o': output = optarg; break;
+        case 'q': queries = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind + 1 != argc)
+        usage();
+    if (metrics.empty())
+        parse_metrics("jaro_winkler", metrics);
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out)
+        die("can't write %s", output);
+
+    /* per worker arenas, decoded strings keep their capacity between rows */
+    struct arena {
+        vector<field> fields;
+        string scratch;
+        wstring a, b;
+        vector<double> values;
+        /* query mode: a block of candidate lines */
+        vector<wstring> block;
+        vector<const wchar_t*> ptrs;
+        vector<size_t> lens, lines;
+        vector<unsigned int> dists;
+    };
+    vector<arena> arenas(threads);
+
+    if (!queries) {
+        input in(argv[optind]);
+        run_pipeline(in, out, threads, [&](unsigned int worker, chunk& c) {
+            arena& w = arenas[worker];
+            const char *p = c.begin, *b, *e;
+            size_t line = c.first_line;
+
+            while (next_line(p, c.end, b, e)) {
+                line++;
+                split_fields(b, e, delim, w.fields, w.scratch);
+                if (w.fields.size() < 2) {
+                    fprintf(stderr, "mymetrics-cli: line %zu: expected two fields\n", line);
+                    continue;
+                }
+                decode(w.fields[0].s, w.fields[0].l, w.a);
+                decode(w.fields[1].s, w.fields[1].l, w.b);
+                w.values.resize(metrics.size());
+                for (size_t m = 0; m < metrics.size(); m++)
+                    w.values[m] = score(metrics[m], w.a, w.b);
+                size_t mark = c.out.size();
+                c.out.append(b, e);
+                if (append_scores(metrics, &w.values[0], 1, delim, c.out))
+                    c.out += '\n';
+                else
+                    c.out.resize(mark);
+            }
+        });
+    } else {
+        /* queries are decoded once and shared by all workers */
+        vector<wstring> query;
+        {
+            input in(queries);
+            chunk c;
+            arena& w = arenas[0];
+            while (in.next(c)) {
+                const char *p = c.begin, *b, *e;
+                while (next_line(p, c.end, b, e)) {
+                    split_fields(b, e, delim, w.fields, w.scratch);
+                    query.push_back(wstring());
+                    decode(w.fields[0].s, w.fields[0].l, query.back());
+                }
+            }
+        }
+
+        /*
+         * Candidates are scored a block of lines at a time so levenshtein
+         * and jaro_winkler run one query against the whole block in the
+         * batched kernels. The block shrinks with many queries, down to a
+         * single line, so a worker keeps at most 1M scores (8 MB), or the
+         * scores of one line when the queries alone take more.
+         */
+        const size_t per_line = max<size_t>(1, query.size() * metrics.size());
+        const size_t block_lines = max<size_t>(1, min<size_t>(256, (1 << 20) / per_line));
+
+        auto score_block = [&](arena& w, size_t count, string& out) {
+            char buf[64];
+
+            w.values.resize(per_line * block_lines);
+            w.dists.resize(block_lines);
+            for (size_t i = 0; i < count; i++) {
+                w.ptrs[i] = w.block[i].c_str();
+                w.lens[i] = w.block[i].size();
+            }
+            for (size_t q = 0; q < query.size(); q++)
+                for (size_t m = 0; m < metrics.size(); m++) {
+                    double *v = &w.values[(q * metrics.size() + m) * block_lines];
+                    switch (metrics[m].id) {
+                    case LEVENSHTEIN:
+                        levenshtein_dist_many(query[q].data(), query[q].size(), &w.ptrs[0], &w.lens[0], count, &w.dists[0]);
+                        for (size_t i = 0; i < count; i++)
+                            v[i] = w.dists[i];
+                        break;
+                    case JARO_WINKLER:
+                        jaro_winkler_dist_many(query[q].data(), query[q].size(), &w.ptrs[0], &w.lens[0], count, v);
+                        break;
+                    default:
+                        for (size_t i = 0; i < count; i++)
+                            v[i] = score(metrics[m], query[q], w.block[i]);
+                    }
+                }
+
+            for (size_t i = 0; i < count; i++)
+                for (size_t q = 0; q < query.size(); q++) {
+                    size_t mark = out.size();
+                    out.append(buf, snprintf(buf, sizeof(buf), "%zu%c%zu", q + 1, delim, w.lines[i]));
+                    if (append_scores(metrics, &w.values[q * metrics.size() * block_lines + i], block_lines, delim, out))
+                        out += '\n';
+                    else
+                        out.resize(mark);
+                }
+        };
+
+        input in(argv[optind]);
+        run_pipeline(in, out, threads, [&](unsigned int worker, chunk& c) {
+            arena& w = arenas[worker];
+            const char *p = c.begin, *b, *e;
+            size_t line = c.first_line, count = 0;
+
+            w.block.resize(block_lines);
+            w.ptrs.resize(block_lines);
+            w.lens.resize(block_lines);
+            w.lines.resize(block_lines);
+            while (next_line(p, c.end, b, e)) {
+                line++;
+                split_fields(b, e, delim, w.fields, w.scratch);
+                decode(w.fields[0].s, w.fields[0].l, w.block[count]);
+                w.lines[count++] = line;
+                if (count == block_lines) {
+                    score_block(w, count, c.out);
+                    count = 0;
+                }
+            }
+            if (count)
+                score_block(w, count, c.out);
+        });
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
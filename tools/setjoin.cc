@@ -0,0 +1,271 @@
+/*
+ * mymetrics-cli setjoin: all pairs with dice (or Jaccard) of bigram sets at
+ * least t, PPJoin style (Xiao, Wang, Lin, Yu, "Efficient Similarity Joins
+ * for Near Duplicate Detection", WWW 2008).
+ *
+ * Sets are the distinct bigrams dice_coeff compares. Bigrams are renamed to
+ * ranks of global frequency, rarest first, and every set is sorted by rank.
+ * A pair reaching t must then share a bigram among the first few of both
+ * sets (prefix filter), have close sizes (length filter) and keep enough
+ * bigrams after every shared one to still reach the overlap (positional
+ * filter). Only the survivors are intersected exactly.
+ *
+ * Dice d and Jaccard j of the same sets are tied by j = d / (2 - d), so both
+ * run as a Jaccard join with the matching threshold.
+ */
+
+#include "cli.h"
+#include "dispatch.h"
+#include "dice.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const double eps = 1e-9;
+
+struct posting {
+    uint32_t rank;    /* record */
+    uint32_t pos;     /* position of the token in it */
+};
+
+/* overlap seen so far with every record, -1 once pruned; touched ones are reset after the probe */
+struct accumulator {
+    vector<int32_t> overlap;
+    vector<uint32_t> touched;
+};
+
+/* bigram sets of one side, ordered by size */
+struct side {
+    corpus text;
+    vector<uint32_t> order;     /* rank -> line */
+    vector<uint64_t> tokens;    /* token ranks of all sets, each sorted */
+    vector<size_t> offsets;
+
+    size_t size(size_t r) const { return offsets[r + 1] - offsets[r]; }
+    const uint64_t *set(size_t r) const { return &tokens[offsets[r]]; }
+};
+
+void bigram_sets(const corpus& text, vector<vector<uint64_t> >& sets) {
+    sets.resize(text.size());
+    for (size_t i = 0; i < text.size(); i++)
+        if (text.pack.is_open() && text.pack.has_bigrams())
+            sets[i].assign(text.pack.bigrams(i), text.pack.bigrams(i) + text.pack.bigram_count(i));
+        else
+            dice_bigrams(text.str(i), text.length(i), sets[i]);
+}
+
+/* renames bigrams to their rank in ascending global frequency */
+void rank_tokens(vector<vector<uint64_t> >* all[], unsigned int count) {
+    vector<uint64_t> every;
+    for (unsigned int s = 0; s < count; s++)
+        for (size_t i = 0; i < all[s]->size(); i++)
+            every.insert(every.end(), (*all[s])[i].begin(), (*all[s])[i].end());
+    sort(every.begin(), every.end());
+
+    vector<uint64_t> distinct;
+    vector<pair<size_t, size_t> > by_frequency;
+    for (size_t i = 0; i < every.size();) {
+        size_t j = i;
+        while (j < every.size() && every[j] == every[i])
+            j++;
+        by_frequency.push_back(make_pair(j - i, distinct.size()));
+        distinct.push_back(every[i]);
+        i = j;
+    }
+    vector<uint64_t>().swap(every);
+    sort(by_frequency.begin(), by_frequency.end());
+
+    vector<uint64_t> rank(distinct.size());
+    for (size_t r = 0; r < by_frequency.size(); r++)
+        rank[by_frequency[r].second] = r;
+
+    for (unsigned int s = 0; s < count; s++)
+        for (size_t i = 0; i < all[s]->size(); i++) {
+            vector<uint64_t>& set = (*all[s])[i];
+            for (size_t k = 0; k < set.size(); k++)
+                set[k] = rank[lower_bound(distinct.begin(), distinct.end(), set[k]) - distinct.begin()];
+            sort(set.begin(), set.end());
+        }
+}
+
+void build_side(side& s, vector<vector<uint64_t> >& sets) {
+    size_t n = sets.size();
+    s.order.clear();
+    for (size_t i = 0; i < n; i++)
+        if (!sets[i].empty())
+            s.order.push_back(i);
+    stable_sort(s.order.begin(), s.order.end(), [&](uint32_t a, uint32_t b) {
+        return sets[a].size() < sets[b].size();
+    });
+
+    s.offsets.assign(1, 0);
+    for (size_t r = 0; r < s.order.size(); r++) {
+        vector<uint64_t>& set = sets[s.order[r]];
+        s.tokens.insert(s.tokens.end(), set.begin(), set.end());
+        s.offsets.push_back(s.tokens.size());
+        vector<uint64_t>().swap(set);
+    }
+}
+
+size_t prefix_length(size_t size, double t) {
+    return size - (size_t)ceil(t * size - eps) + 1;
+}
+
+void usage() {
+    fputs("usage: mymetrics-cli setjoin [-m dice|jaccard] -t threshold [-d delimiter] [-j threads] [-o output] file [file2]\n"
+          "prints line1 <tab> line2 <tab> score for every pair of bigram sets reaching the threshold\n", stderr);
+    exit(1);
+}
+
+}
+
+int setjoin_main(int argc, char **argv) {
+    const char *output = 0;
+    char delim = '\t';
+    unsigned int threads = default_threads();
+    bool use_dice = true;
+    double t = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:d:j:o:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (!strcmp(optarg, "dice"))
+                use_dice = true;
+            else if (!strcmp(optarg, "jaccard"))
+                use_dice = false;
+            else
+                usage();
+            break;
+        case 't': t = atof(optarg); break;
+        case 'd': delim = optarg[0]; break;
+        case 'j': threads = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'o': output = optarg; break;
+        default: usage();
+        }
+    }
+    if (t <= 0 || t > 1 || optind >= argc || optind + 2 < argc)
+        usage();
+
+    const double tj = use_dice ? t / (2 - t) : t;
+    const bool self = optind + 1 == argc;
+
+    side r, s_side;
+    vector<vector<uint64_t> > r_sets, s_sets;
+    load_corpus(argv[optind], delim, r.text);
+    bigram_sets(r.text, r_sets);
+    if (!self) {
+        load_corpus(argv[optind + 1], delim, s_side.text);
+        bigram_sets(s_side.text, s_sets);
+    }
+    vector<vector<uint64_t> >* all[] = { &r_sets, &s_sets };
+    rank_tokens(all, self ? 1 : 2);
+    build_side(r, r_sets);
+    if (!self)
+        build_side(s_side, s_sets);
+    const side& s = self ? r : s_side;
+
+    /*
+     * Static index of the record prefixes, postings in record order (and so
+     * in size order). A self join indexes the shorter mid-prefix and a probe
+     * only looks at records before it.
+     */
+    uint64_t tokens = 0;
+    for (size_t i = 0; i < r.tokens.size(); i++)
+        tokens = max(tokens, r.tokens[i] + 1);
+    for (size_t i = 0; i < s.tokens.size(); i++)
+        tokens = max(tokens, s.tokens[i] + 1);
+
+    vector<size_t> list_start(tokens + 1, 0);
+    vector<posting> postings;
+    const double index_t = self ? 2 * tj / (1 + tj) : tj;
+    for (size_t rank = 0; rank < r.order.size(); rank++) {
+        size_t p = min(prefix_length(r.size(rank), index_t), r.size(rank));
+        for (size_t i = 0; i < p; i++)
+            list_start[r.set(rank)[i] + 1]++;
+    }
+    for (size_t w = 0; w < tokens; w++)
+        list_start[w + 1] += list_start[w];
+    postings.resize(list_start[tokens]);
+    {
+        vector<size_t> fill(list_start.begin(), list_start.end() - 1);
+        for (size_t rank = 0; rank < r.order.size(); rank++) {
+            size_t p = min(prefix_length(r.size(rank), index_t), r.size(rank));
+            for (size_t i = 0; i < p; i++) {
+                posting e = { (uint32_t)rank, (uint32_t)i };
+                postings[fill[r.set(rank)[i]]++] = e;
+            }
+        }
+    }
+
+    shared_output out(output);
+    vector<accumulator> accs(threads);
+    vector<string> bufs(threads);
+
+    parallel_for(s.order.size(), threads, [&](unsigned int w, size_t rank) {
+        accumulator& acc = accs[w];
+        string& buf = bufs[w];
+        const uint64_t *x = s.set(rank);
+        size_t lx = s.size(rank);
+        size_t p = min(prefix_length(lx, tj), lx);
+        size_t min_size = (size_t)ceil(tj * lx - eps);
+        size_t max_size = self ? lx : (size_t)floor(lx / tj + eps);
+        char num[80];
+
+        if (acc.overlap.empty())
+            acc.overlap.assign(r.order.size(), 0);
+        acc.touched.clear();
+
+        for (size_t i = 0; i < p; i++) {
+            const posting *b = &postings[list_start[x[i]]], *e = &postings[list_start[x[i] + 1]];
+            /* length filter: postings are in size order */
+            b = lower_bound(b, e, min_size, [&](const posting& a, size_t size) { return r.size(a.rank) < size; });
+            for (; b != e; ++b) {
+                if (self ? b->rank >= rank : r.size(b->rank) > max_size)
+                    break;
+                int32_t& o = acc.overlap[b->rank];
+                if (o < 0)
+                    continue;
+                if (!o)
+                    acc.touched.push_back(b->rank);
+
+                /* positional filter: what is left after a shared token must still reach alpha */
+                size_t ly = r.size(b->rank);
+                size_t alpha = (size_t)ceil(tj / (1 + tj) * (lx + ly) - eps);
+                size_t ubound = 1 + min(lx - i - 1, ly - b->pos - 1);
+                o = o + ubound >= alpha ? o + 1 : -1;
+            }
+        }
+
+        for (size_t k = 0; k < acc.touched.size(); k++) {
+            uint32_t y = acc.touched[k];
+            size_t ly = r.size(y);
+            bool pruned = acc.overlap[y] < 0;
+
+            acc.overlap[y] = 0;
+            if (pruned)
+                continue;
+
+            size_t common = kernels().intersect(x, lx, r.set(y), ly);
+            double score = use_dice ? 2.0 * common / (lx + ly) : (double)common / (lx + ly - common);
+            if (score < t - eps)
+                continue;
+
+            size_t a = r.order[y] + 1, b = s.order[rank] + 1;
+            if (self && a > b)
+                swap(a, b);
+            buf.append(num, snprintf(num, sizeof(num), "%zu\t%zu\t%.6g\n", a, b, score));
+        }
+        out.flush(buf);
+    });
+
+    for (unsigned int w = 0; w < threads; w++)
+        out.flush(bufs[w], true);
+    return 0;
+}